@@ -0,0 +1,611 @@
+// Benchmark suite for the Value engine.
+//
+// Micro benchmarks: node creation per operator, backward over chains and wide fan-in/fan-out graphs,
+// Neuron/Layer/MLP forward at several widths and depths, MLP construction and optimizer steps. Macro benchmarks: full training
+// epochs on a fixed synthetic regression set, through the scalar graph, the batched path, a captured plan and
+// the data-parallel trainer. The jacobian group compares forward and reverse mode; the precision group runs the same kernels and
+// models in float and double.
+//
+// Results go to stdout as JSON (or to --out FILE), a readable table goes to stderr. Inputs are generated from
+// fixed seeds, so runs of different versions time the same work.
+//
+//      micrograd_bench [--filter SUBSTRING] [--min-time SECONDS] [--out FILE]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dense.h"
+#include "forward.h"
+#include "kernels.h"
+#include "nn.h"
+#include "optim.h"
+#include "parallel.h"
+#include "plan.h"
+
+using namespace micrograd;
+
+namespace{
+    using clock_type = std::chrono::steady_clock;
+
+    struct Result{
+        std::string group;
+        std::string name;
+        std::string unit;           // what one item is
+        double items;               // items per repetition
+        int repetitions;
+        double median_ns;           // per repetition
+        double min_ns;
+    };
+
+    //=====================================================================================================================
+    // Harness
+    //
+    // Each benchmark is a body run once per repetition, plus an optional untimed teardown run after it (e.g.
+    // to free the nodes a creation benchmark built). One untimed warm-up repetition calibrates how many timed
+    // repetitions fit into min_time; the median and minimum are reported.
+    //=====================================================================================================================
+
+    class Suite{
+        public:
+            std::string filter;
+            double min_time = 0.25;
+            std::vector<Result> results;
+
+            void run(const std::string& group, const std::string& name, const std::string& unit, double items,
+                     const std::function<void()>& body, const std::function<void()>& teardown = nullptr){
+                const std::string full = group + "/" + name;
+                if(!filter.empty() && full.find(filter) == std::string::npos) return;
+
+                double warm = time_once(body, teardown);
+                int reps = static_cast<int>(std::clamp(min_time / std::max(warm, 1e-9), 5.0, 1000.0));
+                std::vector<double> samples;
+                samples.reserve(reps);
+                for(int r=0; r<reps; ++r){
+                    samples.push_back(time_once(body, teardown));
+                }
+                std::sort(samples.begin(), samples.end());
+
+                Result res{group, name, unit, items, reps, samples[samples.size()/2]*1e9, samples.front()*1e9};
+                std::fprintf(stderr, "%-40s %14.1f ns %16.4g %s/s\n", full.c_str(), res.median_ns, items / (res.median_ns*1e-9), unit.c_str());
+                results.push_back(res);
+            }
+
+            void write_json(std::FILE* out) const{
+                std::fprintf(out, "{\n");
+                std::fprintf(out, "  \"schema\": 1,\n");
+                std::fprintf(out, "  \"context\": {\"compiler\": \"%s\", \"avx2\": %s, \"assertions\": %s, \"hardware_threads\": %u},\n",
+                             compiler(), MICROGRAD_AVX2 ? "true" : "false",
+#ifdef NDEBUG
+                             "false",
+#else
+                             "true",
+#endif
+                             std::thread::hardware_concurrency());
+                std::fprintf(out, "  \"benchmarks\": [\n");
+                for(size_t i=0; i<results.size(); ++i){
+                    const Result& r = results[i];
+                    std::fprintf(out, "    {\"group\": \"%s\", \"name\": \"%s\", \"unit\": \"%s\", \"items\": %.0f, \"repetitions\": %d, "
+                                      "\"median_ns\": %.1f, \"min_ns\": %.1f, \"ns_per_item\": %.4f, \"items_per_second\": %.6g}%s\n",
+                                 r.group.c_str(), r.name.c_str(), r.unit.c_str(), r.items, r.repetitions,
+                                 r.median_ns, r.min_ns, r.median_ns / r.items, r.items / (r.median_ns*1e-9),
+                                 i+1 < results.size() ? "," : "");
+                }
+                std::fprintf(out, "  ]\n}\n");
+            }
+
+        private:
+            static double time_once(const std::function<void()>& body, const std::function<void()>& teardown){
+                auto start = clock_type::now();
+                body();
+                double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+                if(teardown) teardown();
+                return elapsed;
+            }
+
+            static const char* compiler(){
+#if defined(__clang__)
+                return "clang " __clang_version__;
+#elif defined(__GNUC__)
+                return "gcc " __VERSION__;
+#else
+                return "unknown";
+#endif
+            }
+    };
+
+    template<typename T = double>
+    std::vector<std::shared_ptr<BasicValue<T>>> make_leaves(size_t n, std::mt19937& gen){
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        std::vector<std::shared_ptr<BasicValue<T>>> leaves;
+        leaves.reserve(n);
+        for(size_t i=0; i<n; ++i){
+            leaves.push_back(std::make_shared<BasicValue<T>>(static_cast<T>(dis(gen))));
+        }
+        return leaves;
+    }
+
+    // Left-deep chain of binary adds, as opposed to the fused micrograd::sum.
+    std::shared_ptr<Value> chain_sum(const std::vector<std::shared_ptr<Value>>& xs){
+        auto total = xs[0];
+        for(size_t i=1; i<xs.size(); ++i){
+            total = (*total) + (*xs[i]);
+        }
+        return total;
+    }
+
+    std::vector<double> layer_shape(size_t width, size_t depth){
+        return std::vector<double>(depth + 1, static_cast<double>(width));
+    }
+
+    //=====================================================================================================================
+    // Micro: node creation
+    //=====================================================================================================================
+
+    void bench_ops(Suite& suite){
+        constexpr size_t N = 1 << 14;
+        std::mt19937 gen(1);
+        auto as = make_leaves(N, gen);
+        auto bs = make_leaves(N, gen);
+        for(auto& b : bs) b->data = 1.5 + 0.5*b->data;    // positive, away from zero, for / and pow
+        std::vector<std::shared_ptr<Value>> keep;
+        keep.reserve(N);
+        auto clear = [&](){ keep.clear(); };
+
+        using OpFn = std::function<std::shared_ptr<Value>(Value&, Value&)>;
+        const std::vector<std::pair<const char*, OpFn>> ops = {
+            {"add",       [](Value& a, Value& b){ return a + b; }},
+            {"add_const", [](Value& a, Value&){ return a + 2.0; }},
+            {"sub",       [](Value& a, Value& b){ return a - b; }},
+            {"mul",       [](Value& a, Value& b){ return a * b; }},
+            {"mul_const", [](Value& a, Value&){ return a * 2.0; }},
+            {"div",       [](Value& a, Value& b){ return a / b; }},
+            {"pow",       [](Value&, Value& b){ return b.pow(1.5); }},
+            {"pow_base",  [](Value& a, Value&){ return a.pow_with_base(2.0); }},
+            {"exp",       [](Value& a, Value&){ return a.exp(); }},
+            {"tanh",      [](Value& a, Value&){ return a.tanh(); }},
+        };
+        for(const auto& op : ops){
+            const OpFn& fn = op.second;
+            suite.run("create", op.first, "ops", N, [&](){
+                for(size_t i=0; i<N; ++i){
+                    keep.push_back(fn(*as[i], *bs[i]));
+                }
+            }, clear);
+        }
+    }
+
+    //=====================================================================================================================
+    // Micro: backward
+    //
+    // The graphs are built once; each repetition re-runs backward() over the cached order.
+    //=====================================================================================================================
+
+    void bench_backward(Suite& suite){
+        std::mt19937 gen(2);
+        for(size_t length : {1000, 100000}){
+            // x_{i+1} = tanh(x_i * w_i + 0.1)
+            auto ws = make_leaves(length, gen);
+            auto x = std::make_shared<Value>(0.5);
+            std::shared_ptr<Value> y = x;
+            for(size_t i=0; i<length; ++i){
+                y = ((*((*y) * (*ws[i]))) + 0.1)->tanh();
+            }
+            const double nodes = y->topological_order().size();
+            suite.run("backward", "chain_" + std::to_string(length), "nodes", nodes, [&](){ y->backward(); });
+        }
+
+        for(size_t width : {1000, 100000}){
+            // sum_i w_i * x_i: every product feeds one long reduction.
+            auto ws = make_leaves(width, gen);
+            auto xs = make_leaves(width, gen);
+            std::vector<std::shared_ptr<Value>> products;
+            for(size_t i=0; i<width; ++i){
+                products.push_back((*ws[i]) * (*xs[i]));
+            }
+            auto loss = chain_sum(products);
+            const double nodes = loss->topological_order().size();
+            suite.run("backward", "fan_in_" + std::to_string(width), "nodes", nodes, [&](){ loss->backward(); });
+
+            // The same reduction as one fused node: linear(ws, xs, 0).
+            auto fused = linear(ws, xs, std::make_shared<Value>(0.0));
+            suite.run("backward", "fan_in_fused_" + std::to_string(width), "operands", 2.0*width, [&](){ fused->backward(); });
+        }
+
+        for(size_t width : {1000, 100000}){
+            // sum_i exp(x * c_i): one leaf read by every branch.
+            auto x = std::make_shared<Value>(0.25);
+            std::vector<std::shared_ptr<Value>> branches;
+            for(size_t i=0; i<width; ++i){
+                branches.push_back(((*x) * (1e-3*(i%17)))->exp());
+            }
+            auto loss = chain_sum(branches);
+            const double nodes = loss->topological_order().size();
+            suite.run("backward", "fan_out_" + std::to_string(width), "nodes", nodes, [&](){ loss->backward(); });
+        }
+
+        {
+            // Scalar MLP 256-256-256-1 with fused neurons, sequential vs the level-scheduled parallel sweep.
+            MLP mlp({256, 256, 256, 1});
+            auto x = make_leaves(256, gen);
+            auto loss = sum(mlp(x));
+            const double nodes = loss->topological_order().size();
+            suite.run("backward", "mlp_w256", "nodes", nodes, [&](){ loss->backward(); });
+            ThreadPool pool;
+            ParallelBackward sweep(loss, pool);
+            suite.run("backward", "mlp_w256_parallel", "nodes", nodes, [&](){ sweep.run(); });
+        }
+    }
+
+    //=====================================================================================================================
+    // Micro: forward
+    //=====================================================================================================================
+
+    void bench_forward(Suite& suite){
+        std::mt19937 gen(3);
+        std::shared_ptr<Value> out;
+        std::vector<std::shared_ptr<Value>> outs;
+        auto clear = [&](){ out.reset(); outs.clear(); };
+
+        for(int width : {4, 16, 64, 256}){
+            Neuron neuron(width);
+            auto x = make_leaves(width, gen);
+            suite.run("forward", "neuron_" + std::to_string(width), "calls", 1, [&](){ out = neuron(x); }, clear);
+        }
+
+        for(int width : {16, 64, 128}){
+            Layer layer(width, width);
+            auto x = make_leaves(width, gen);
+            suite.run("forward", "layer_" + std::to_string(width) + "x" + std::to_string(width), "calls", 1,
+                      [&](){ outs = layer(x); }, clear);
+        }
+
+        for(size_t depth : {1, 2, 4, 8}){
+            const size_t width = 32;
+            MLP mlp(layer_shape(width, depth));
+            auto x = make_leaves(width, gen);
+            suite.run("forward", "mlp_w32_d" + std::to_string(depth), "calls", 1, [&](){ outs = mlp(x); }, clear);
+        }
+
+        for(size_t depth : {1, 2, 4, 8}){
+            const size_t width = 32, batch = 64;
+            MLP mlp(layer_shape(width, depth));
+            std::vector<double> xs(batch*width);
+            std::uniform_real_distribution<> dis(-1.0, 1.0);
+            for(auto& v : xs) v = dis(gen);
+            suite.run("forward", "mlp_batch64_w32_d" + std::to_string(depth), "samples", batch,
+                      [&](){ out = mlp(Tensor::from_data(batch, width, xs.data())); }, clear);
+        }
+    }
+
+    //=====================================================================================================================
+    // Micro: model construction
+    //
+    // A 1M-parameter MLP built sequentially and on a thread pool, from a fixed seed. Teardown frees it untimed.
+    // Each layer's ParameterBlock is a fresh mapping, so every repetition pays the page faults of a cold start.
+    //=====================================================================================================================
+
+    void bench_construct(Suite& suite){
+        const std::vector<double> shape = {512, 1024, 512, 10};
+        double num_params = 0;
+        for(size_t l=0; l+1<shape.size(); ++l) num_params += (shape[l] + 1) * shape[l+1];
+        InitOptions init;
+        init.scheme = Init::XavierUniform;
+        init.seed = 7;
+        std::unique_ptr<MLP> mlp;
+        auto clear = [&](){ mlp.reset(); };
+
+        suite.run("construct", "mlp_1m", "params", num_params, [&](){ mlp.reset(new MLP(shape, init)); }, clear);
+        ThreadPool pool;
+        suite.run("construct", "mlp_1m_parallel", "params", num_params,
+                  [&](){ mlp.reset(new MLP(build_mlp(shape, init, pool))); }, clear);
+    }
+
+    //=====================================================================================================================
+    // Micro: optimizer steps
+    //
+    // One step of each optimizer over the parameters of a 1M-parameter MLP, updated in place, then SGD and Adam
+    // over the same model in float.
+    //=====================================================================================================================
+
+    void bench_optim(Suite& suite){
+        const std::vector<double> shape = {512, 1024, 512, 10};
+        InitOptions init;
+        init.seed = 7;
+        MLP mlp(shape, init);
+        ParameterStore store;
+        store.add(mlp.parameters());
+        const double num_params = store.size();
+
+        SGD sgd(store, 0.01);
+        Momentum momentum(store, 0.01);
+        Adam adam(store, 1e-3);
+        suite.run("optim", "sgd_1m", "params", num_params, [&](){ sgd.step(); });
+        suite.run("optim", "momentum_1m", "params", num_params, [&](){ momentum.step(); });
+        suite.run("optim", "adam_1m", "params", num_params, [&](){ adam.step(); });
+
+        MLPf mlpf(shape, init);
+        ParameterStoref storef;
+        storef.add(mlpf.parameters());
+        SGDf sgdf(storef, 0.01f);
+        Adamf adamf(storef, 1e-3f);
+        suite.run("optim", "sgd_1m_f32", "params", num_params, [&](){ sgdf.step(); });
+        suite.run("optim", "adam_1m_f32", "params", num_params, [&](){ adamf.step(); });
+    }
+
+    //=====================================================================================================================
+    // Micro: float vs double
+    //
+    // Each case runs once per scalar type, named <case>_f32 / <case>_f64. The batched cases seed backward from
+    // one output element so the timing is the layer kernels, not a scalar loss over every output.
+    //=====================================================================================================================
+
+    template<typename T>
+    void bench_precision_type(Suite& suite, const std::string& suffix){
+        std::mt19937 gen(5);
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        auto random_vector = [&](size_t n){
+            std::vector<T> v(n);
+            for(auto& e : v) e = static_cast<T>(dis(gen));
+            return v;
+        };
+
+        {
+            const size_t n = 4096;
+            auto a = random_vector(n), b = random_vector(n);
+            volatile T sink = 0;
+            suite.run("precision", "dot_4096" + suffix, "flops", 2.0*n, [&](){ sink = kernels::dot(a.data(), b.data(), n); });
+        }
+
+        {
+            const size_t batch = 64, width = 128;
+            BasicDenseLayer<T> layer(width, width);
+            auto xs = random_vector(batch*width);
+            std::shared_ptr<BasicValue<T>> loss;
+            suite.run("precision", "dense_128x128_batch64" + suffix, "samples", batch, [&](){
+                loss = layer(BasicTensor<T>::from_data(batch, width, xs.data()))->at(0, 0);
+                loss->backward();
+            }, [&](){ loss.reset(); });
+        }
+
+        {
+            const size_t batch = 64, width = 32;
+            BasicMLP<T> mlp(layer_shape(width, 4));
+            auto xs = random_vector(batch*width);
+            std::shared_ptr<BasicValue<T>> loss;
+            suite.run("precision", "mlp_batch64_w32_d4" + suffix, "samples", batch, [&](){
+                loss = mlp(BasicTensor<T>::from_data(batch, width, xs.data()))->at(0, 0);
+                loss->backward();
+            }, [&](){ loss.reset(); });
+        }
+
+        {
+            const size_t width = 32;
+            BasicMLP<T> mlp(layer_shape(width, 4));
+            auto x = make_leaves<T>(width, gen);
+            std::shared_ptr<BasicValue<T>> loss;
+            suite.run("precision", "mlp_w32_d4" + suffix, "calls", 1, [&](){
+                loss = sum<T>(mlp(x));
+                loss->backward();
+            }, [&](){ loss.reset(); });
+        }
+    }
+
+    //=====================================================================================================================
+    // Micro: Jacobians
+    //
+    // Full Jacobian of an MLP 32-32-32-32-8: forward mode with batched tangents (8 columns per pass) against
+    // one reverse-mode vjp per output row.
+    //=====================================================================================================================
+
+    void bench_jacobian(Suite& suite){
+        std::mt19937 gen(6);
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        MLP mlp({32, 32, 32, 32, 8});
+        std::vector<double> x(32);
+        for(auto& v : x) v = dis(gen);
+        std::vector<double> J;
+
+        suite.run("jacobian", "mlp_32x8_forward", "calls", 1, [&](){ J = jacobian(mlp, x); });
+        suite.run("jacobian", "mlp_32x8_reverse", "calls", 1, [&](){
+            for(size_t r=0; r<8; ++r){
+                std::vector<double> u(8, 0.0);
+                u[r] = 1.0;
+                J = vjp(mlp, x, u);
+            }
+        });
+    }
+
+    void bench_precision(Suite& suite){
+        bench_precision_type<float>(suite, "_f32");
+        bench_precision_type<double>(suite, "_f64");
+    }
+
+    //=====================================================================================================================
+    // Macro: training epochs
+    //
+    // 256 samples of y = sin(sum x) / 2 over 8 inputs, mini-batches of 32, MLP 8-32-32-1, squared error,
+    // SGD on a ParameterStore.
+    //=====================================================================================================================
+
+    struct Dataset{
+        size_t n = 256, dim = 8, batch = 32;
+        std::vector<double> X, Y;
+
+        Dataset(){
+            std::mt19937 gen(4);
+            std::uniform_real_distribution<> dis(-1.0, 1.0);
+            X.resize(n*dim);
+            Y.resize(n);
+            for(size_t i=0; i<n; ++i){
+                double s = 0.0;
+                for(size_t j=0; j<dim; ++j){
+                    X[i*dim + j] = dis(gen);
+                    s += X[i*dim + j];
+                }
+                Y[i] = 0.5*std::sin(s);
+            }
+        }
+    };
+
+    const std::vector<double> kTrainShape = {8, 32, 32, 1};
+
+    void bench_training(Suite& suite){
+        const Dataset data;
+
+        {
+            // One graph per sample, scalar Values throughout.
+            MLP mlp(kTrainShape);
+            ParameterStore store;
+            store.add(mlp.parameters());
+            SGD optimizer(store, 0.01);
+            std::vector<std::vector<std::shared_ptr<Value>>> xs(data.n);
+            for(size_t i=0; i<data.n; ++i){
+                for(size_t j=0; j<data.dim; ++j){
+                    xs[i].push_back(std::make_shared<Value>(data.X[i*data.dim + j]));
+                }
+            }
+            suite.run("train", "scalar_epoch", "samples", data.n, [&](){
+                for(size_t begin=0; begin<data.n; begin+=data.batch){
+                    std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
+                    for(size_t i=begin; i<begin+data.batch; ++i){
+                        auto diff = (*mlp(xs[i])[0]) - data.Y[i];
+                        loss = (*loss) + (*diff->pow(2.0));
+                    }
+                    loss->backward(/*retain_graph=*/false);
+                    optimizer.step();
+                }
+            });
+
+            // The same epoch with every layer recomputed during backward.
+            suite.run("train", "scalar_epoch_checkpointed", "samples", data.n, [&](){
+                for(size_t begin=0; begin<data.n; begin+=data.batch){
+                    std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
+                    for(size_t i=begin; i<begin+data.batch; ++i){
+                        auto diff = (*mlp.checkpointed(xs[i])[0]) - data.Y[i];
+                        loss = (*loss) + (*diff->pow(2.0));
+                    }
+                    loss->backward(/*retain_graph=*/false);
+                    optimizer.step();
+                }
+            });
+        }
+
+        {
+            // One batched graph per mini-batch.
+            MLP mlp(kTrainShape);
+            ParameterStore store;
+            store.add(mlp.parameters());
+            SGD optimizer(store, 0.01);
+            suite.run("train", "batched_epoch", "samples", data.n, [&](){
+                for(size_t begin=0; begin<data.n; begin+=data.batch){
+                    auto y_pred = mlp(Tensor::from_data(data.batch, data.dim, data.X.data() + begin*data.dim));
+                    std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
+                    for(size_t i=0; i<data.batch; ++i){
+                        auto diff = (*y_pred->at(i, 0)) - data.Y[begin + i];
+                        loss = (*loss) + (*diff->pow(2.0));
+                    }
+                    loss->backward(/*retain_graph=*/false);
+                    optimizer.step();
+                }
+            });
+        }
+
+        {
+            // The batched graph captured once and replayed with new inputs and targets.
+            MLP mlp(kTrainShape);
+            ParameterStore store;
+            store.add(mlp.parameters());
+            SGD optimizer(store, 0.01);
+            auto X = Tensor::from_data(data.batch, data.dim, data.X.data());
+            std::mt19937 gen(5);
+            auto targets = make_leaves(data.batch, gen);
+            auto plan = Plan::capture([&](){
+                auto y_pred = mlp(X);
+                std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
+                for(size_t i=0; i<data.batch; ++i){
+                    auto diff = (*y_pred->at(i, 0)) - (*targets[i]);
+                    loss = (*loss) + (*diff->pow(2.0));
+                }
+                return loss;
+            });
+            suite.run("train", "plan_epoch", "samples", data.n, [&](){
+                for(size_t begin=0; begin<data.n; begin+=data.batch){
+                    std::copy(data.X.begin() + begin*data.dim, data.X.begin() + (begin + data.batch)*data.dim, X->values.begin());
+                    for(size_t i=0; i<data.batch; ++i){
+                        targets[i]->data = data.Y[begin + i];
+                    }
+                    plan.forward();
+                    plan.backward();
+                    optimizer.step();
+                }
+            });
+        }
+
+        {
+            // Each mini-batch sharded over the thread pool, one shard per thread.
+            MLP mlp(kTrainShape);
+            ParameterStore store;
+            store.add(mlp.parameters());
+            SGD optimizer(store, 0.01);
+            DataParallelTrainer trainer(mlp, 0, std::max(1u, std::min(4u, std::thread::hardware_concurrency())));
+            suite.run("train", "data_parallel_epoch", "samples", data.n, [&](){
+                for(size_t begin=0; begin<data.n; begin+=data.batch){
+                    trainer.compute_gradients(data.batch, [&](MLP& model, size_t lo, size_t hi){
+                        auto y_pred = model(Tensor::from_data(hi - lo, data.dim, data.X.data() + (begin + lo)*data.dim));
+                        std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
+                        for(size_t i=lo; i<hi; ++i){
+                            auto diff = (*y_pred->at(i - lo, 0)) - data.Y[begin + i];
+                            loss = (*loss) + (*diff->pow(2.0));
+                        }
+                        return loss;
+                    });
+                    optimizer.step();
+                }
+            });
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    Suite suite;
+    const char* out_path = nullptr;
+    for(int i=1; i<argc; ++i){
+        if(!std::strcmp(argv[i], "--filter") && i+1 < argc){
+            suite.filter = argv[++i];
+        } else if(!std::strcmp(argv[i], "--min-time") && i+1 < argc){
+            suite.min_time = std::atof(argv[++i]);
+        } else if(!std::strcmp(argv[i], "--out") && i+1 < argc){
+            out_path = argv[++i];
+        } else{
+            std::fprintf(stderr, "usage: %s [--filter SUBSTRING] [--min-time SECONDS] [--out FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_ops(suite);
+    bench_backward(suite);
+    bench_forward(suite);
+    bench_construct(suite);
+    bench_optim(suite);
+    bench_precision(suite);
+    bench_jacobian(suite);
+    bench_training(suite);
+
+    std::FILE* out = out_path ? std::fopen(out_path, "w") : stdout;
+    if(!out){
+        std::fprintf(stderr, "cannot open %s\n", out_path);
+        return 1;
+    }
+    suite.write_json(out);
+    if(out != stdout) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Compares one training step (forward + backward, single sample) of the scalar MLP in nn.h against
+// a stack of DenseLayers of the same shape, across layer widths.
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "nn.h"
+#include "dense.h"
+
+using namespace micrograd;
+
+namespace{
+    using clock_type = std::chrono::steady_clock;
+
+    double seconds_since(clock_type::time_point start){
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    // Returns seconds per step.
+    double bench_mlp(int width, int iters){
+        MLP mlp({static_cast<double>(width), static_cast<double>(width), static_cast<double>(width)});
+        std::vector<std::shared_ptr<Value>> x;
+        for(int i=0; i<width; ++i){
+            x.push_back(std::make_shared<Value>(0.01*(i%13)));
+        }
+
+        auto start = clock_type::now();
+        for(int it=0; it<iters; ++it){
+            auto loss = sum(mlp(x));
+            loss->backward(/*retain_graph=*/false);
+        }
+        return seconds_since(start) / iters;
+    }
+
+    double bench_dense(int width, int iters){
+        DenseLayer l1(width, width), l2(width, width);
+        std::vector<double> x(width);
+        for(int i=0; i<width; ++i){
+            x[i] = 0.01*(i%13);
+        }
+
+        auto start = clock_type::now();
+        for(int it=0; it<iters; ++it){
+            auto y = l2(l1(Tensor::from_data(1, width, x.data())));
+            auto loss = sum(y->to_values());
+            loss->backward(/*retain_graph=*/false);
+        }
+        return seconds_since(start) / iters;
+    }
+}
+
+int main(){
+    std::printf("%8s %16s %16s %10s\n", "width", "mlp us/step", "dense us/step", "speedup");
+    for(int width : {16, 64, 128, 256, 512}){
+        int mlp_iters = std::max(2, 200000 / (width*width));
+        int dense_iters = std::max(20, 20000000 / (width*width));
+        double t_mlp = bench_mlp(width, mlp_iters);
+        double t_dense = bench_dense(width, dense_iters);
+        std::printf("%8d %16.2f %16.2f %9.1fx\n", width, t_mlp*1e6, t_dense*1e6, t_mlp/t_dense);
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Per-sample inference latency of the autograd path, mlp(x), against the no-grad MLP::predict,
+// reported as p50/p99 over many single-sample calls. Also checks that both paths agree bit for bit.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "nn.h"
+
+using namespace micrograd;
+
+namespace{
+    using clock_type = std::chrono::steady_clock;
+
+    struct Percentiles{
+        double p50;
+        double p99;
+    };
+
+    Percentiles percentiles(std::vector<double> us){
+        std::sort(us.begin(), us.end());
+        return {us[us.size()/2], us[std::min(us.size()-1, us.size()*99/100)]};
+    }
+
+    void bench(const std::vector<double>& shape, int samples){
+        MLP mlp(shape);
+        const size_t num_in = shape.front(), num_out = shape.back();
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        std::vector<std::vector<double>> xs(samples, std::vector<double>(num_in));
+        std::vector<std::vector<std::shared_ptr<Value>>> xv(samples);
+        for(int s=0; s<samples; ++s){
+            for(size_t i=0; i<num_in; ++i){
+                xs[s][i] = dis(gen);
+                xv[s].push_back(std::make_shared<Value>(xs[s][i]));
+            }
+        }
+
+        std::vector<double> graph_us, predict_us;
+        std::vector<double> y(num_out);
+        bool identical = true;
+        for(int s=0; s<samples; ++s){
+            auto start = clock_type::now();
+            auto out = mlp(xv[s]);
+            graph_us.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - start).count());
+
+            start = clock_type::now();
+            mlp.predict(xs[s].data(), y.data());
+            predict_us.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - start).count());
+
+            for(size_t j=0; j<num_out; ++j){
+                identical = identical && (out[j]->data == y[j]);
+            }
+        }
+
+        auto g = percentiles(graph_us);
+        auto p = percentiles(predict_us);
+        std::string name;
+        for(size_t i=0; i<shape.size(); ++i){
+            name += (i ? "-" : "") + std::to_string(static_cast<int>(shape[i]));
+        }
+        std::printf("%-16s %12.2f %12.2f %12.3f %12.3f %10s\n", name.c_str(), g.p50, g.p99, p.p50, p.p99, identical ? "yes" : "NO");
+    }
+}
+
+int main(){
+    std::printf("%-16s %12s %12s %12s %12s %10s\n", "mlp", "graph p50us", "graph p99us", "pred p50us", "pred p99us", "identical");
+    bench({3, 4, 1}, 20000);
+    bench({16, 64, 64, 1}, 2000);
+    bench({64, 256, 256, 10}, 200);
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Throughput of int8 inference (QuantizedMLP::predict) against the double no-grad path (MLP::predict), in
+// samples per second over a fixed set of inputs, with the accuracy report of the quantized model on the same
+// inputs. Models use Xavier initialization from a fixed seed, so runs are comparable. The last two columns
+// are the quantized weights, scales and biases as a share of the same parameters in plain double and float
+// arrays.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "nn.h"
+#include "quantize.h"
+
+using namespace micrograd;
+
+namespace{
+    using clock_type = std::chrono::steady_clock;
+
+    // Samples per second of predict_all(), repeated until at least min_time has passed.
+    template<typename F>
+    double throughput(size_t samples, F&& predict_all, double min_time = 0.5){
+        predict_all();
+        size_t done = 0;
+        const auto start = clock_type::now();
+        double elapsed = 0.0;
+        do{
+            predict_all();
+            done += samples;
+            elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+        } while(elapsed < min_time);
+        return done / elapsed;
+    }
+
+    void bench(const std::vector<double>& shape, size_t samples){
+        InitOptions init;
+        init.scheme = Init::XavierUniform;
+        init.seed = 42;
+        MLP mlp(shape, init);
+        QuantizedMLP q(mlp);
+        const size_t num_in = shape.front(), num_out = shape.back();
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        std::vector<double> X(samples*num_in), Y(samples*num_out);
+        for(auto& v : X) v = dis(gen);
+
+        const double ref = throughput(samples, [&](){ mlp.predict(X.data(), samples, Y.data()); });
+        const double quant = throughput(samples, [&](){ q.predict(X.data(), samples, Y.data()); });
+        const QuantizationReport report = quantization_report(mlp, q, X.data(), samples);
+
+        std::string name;
+        for(size_t i=0; i<shape.size(); ++i){
+            name += (i ? "-" : "") + std::to_string(static_cast<int>(shape[i]));
+        }
+        std::printf("%-18s %14.0f %14.0f %8.2fx %12.3g %12.3g %10.2f%% %10.1f%% %10.1f%%\n", name.c_str(), ref, quant, quant / ref,
+                    report.max_abs_error, report.mean_abs_error, 100.0 * report.argmax_agreement,
+                    100.0 * report.quantized_bytes / report.double_bytes, 100.0 * report.quantized_bytes / report.float_bytes);
+    }
+}
+
+int main(){
+    std::printf("%-18s %14s %14s %9s %12s %12s %11s %11s %11s\n", "mlp", "double smp/s", "int8 smp/s", "speedup",
+                "max abs err", "mean abs err", "argmax", "vs f64", "vs f32");
+    bench({16, 64, 64, 1}, 2000);
+    bench({64, 256, 256, 10}, 1000);
+    bench({256, 1024, 1024, 10}, 200);
+    bench({784, 512, 512, 10}, 200);
+    return 0;
+}
@@ -0,0 +1,77 @@
+// Load generator for the inference server (src/serve.h).
+//
+// Serves a randomly initialised MLP in-process and drives it with closed-loop clients or an open-loop
+// Poisson arrival process, then reports throughput, queue time, latency percentiles and the batch size
+// distribution. Statistics go to stderr as a table and to stdout (or --out FILE) as JSON.
+//
+//      micrograd_serve_bench [--shape 16,64,64,4] [--max-batch N] [--max-delay-us US] [--workers N]
+//                            [--clients N | --rate REQ_PER_S] [--duration S] [--out FILE]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "serve.h"
+
+using namespace micrograd;
+
+int main(int argc, char** argv){
+    std::vector<double> shape = {16, 64, 64, 4};
+    ServerOptions options;
+    LoadOptions load;
+    const char* out_path = nullptr;
+
+    for(int i=1; i<argc; ++i){
+        const bool has_value = i+1 < argc;
+        if(!std::strcmp(argv[i], "--shape") && has_value){
+            shape.clear();
+            std::stringstream ss(argv[++i]);
+            std::string item;
+            while(std::getline(ss, item, ',')) shape.push_back(std::atof(item.c_str()));
+        } else if(!std::strcmp(argv[i], "--max-batch") && has_value){
+            options.max_batch = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!std::strcmp(argv[i], "--max-delay-us") && has_value){
+            options.max_delay = std::chrono::microseconds(std::strtoul(argv[++i], nullptr, 10));
+        } else if(!std::strcmp(argv[i], "--workers") && has_value){
+            options.num_workers = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!std::strcmp(argv[i], "--clients") && has_value){
+            load.clients = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!std::strcmp(argv[i], "--rate") && has_value){
+            load.rate = std::atof(argv[++i]);
+        } else if(!std::strcmp(argv[i], "--duration") && has_value){
+            load.duration_s = std::atof(argv[++i]);
+        } else if(!std::strcmp(argv[i], "--out") && has_value){
+            out_path = argv[++i];
+        } else{
+            std::fprintf(stderr, "usage: %s [--shape 16,64,64,4] [--max-batch N] [--max-delay-us US] [--workers N] "
+                                 "[--clients N | --rate REQ_PER_S] [--duration S] [--out FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(shape.size() < 2 || options.max_batch == 0){
+        std::fprintf(stderr, "need at least two layer sizes and --max-batch >= 1\n");
+        return 1;
+    }
+
+    MLP mlp(shape);
+    InferenceServer server(mlp, options);
+    const ServerStats stats = generate_load(server, static_cast<size_t>(shape[0]), load);
+
+    std::fprintf(stderr, "workers %zu, max batch %zu, max delay %lld us, %s\n", options.num_workers, options.max_batch,
+                 static_cast<long long>(options.max_delay.count()),
+                 load.rate > 0.0 ? ("open loop at " + std::to_string(static_cast<long long>(load.rate)) + " req/s").c_str()
+                                 : ("closed loop, " + std::to_string(load.clients) + " clients").c_str());
+    stats.print(stderr);
+
+    std::FILE* out = out_path ? std::fopen(out_path, "w") : stdout;
+    if(!out){
+        std::fprintf(stderr, "cannot open %s\n", out_path);
+        return 1;
+    }
+    std::fprintf(out, "%s\n", stats.to_json().c_str());
+    if(out != stdout) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Compares graph construction and backward throughput of the shared_ptr engine (block.h)
+// against the arena-backed tape engine (tape.h), and the heap bytes each spends per node.
+//
+// The workload is a neuron-shaped expression, tanh(b + w0*x0 + w1*x1 + ...), rebuilt every
+// iteration the same way the training loop in main.cpp rebuilds its graph. Both engines create
+// their inputs x as fresh leaves every iteration, so both build 3*width + 1 nodes per iteration.
+//
+// bytes/node is measured, not computed: the live heap bytes a graph holds once it has been built
+// (for the tape, its arena grown from empty, spare capacity included), divided by its nodes.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <malloc.h>
+
+#include "block.h"
+#include "tape.h"
+
+using namespace micrograd;
+
+namespace{
+    std::size_t g_alloc_count = 0;
+    std::size_t g_live_bytes = 0;
+}
+
+void* operator new(std::size_t size){
+    g_alloc_count += 1;
+    if(void* p = std::malloc(size)){
+        g_live_bytes += malloc_usable_size(p);
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept{
+    if(p) g_live_bytes -= malloc_usable_size(p);
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+namespace{
+    using clock_type = std::chrono::steady_clock;
+
+    double seconds_since(clock_type::time_point start){
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    struct Result{
+        double build_nodes_per_sec;
+        double backward_nodes_per_sec;
+        double bytes_per_node;
+        double allocs_per_node;
+    };
+
+    Result bench_value_engine(int width, int iters){
+        std::vector<std::shared_ptr<Value>> ws;
+        for(int i=0; i<width; ++i){
+            ws.push_back(std::make_shared<Value>(0.01*(i%7)));
+        }
+        auto b = std::make_shared<Value>(0.1);
+        const double nodes = 3.0*width + 1;
+
+        double build_time = 0.0, backward_time = 0.0;
+        std::size_t bytes = 0, allocs = 0;
+        for(int it=0; it<iters; ++it){
+            const std::size_t live_before = g_live_bytes, allocs_before = g_alloc_count;
+            auto start = clock_type::now();
+            auto out = b;
+            for(int i=0; i<width; ++i){
+                auto x = std::make_shared<Value>(0.02*(i%5));
+                auto mult = (*ws[i]) * (*x);
+                out = (*out) + (*mult);
+            }
+            out = out->tanh();
+            build_time += seconds_since(start);
+            bytes += g_live_bytes - live_before;
+            allocs += g_alloc_count - allocs_before;
+
+            start = clock_type::now();
+            out->backward();
+            backward_time += seconds_since(start);
+        }
+        return {nodes*iters/build_time, nodes*iters/backward_time, bytes/(nodes*iters), allocs/(nodes*iters)};
+    }
+
+    // Live arena bytes of a tape grown from empty while recording the parameters and one iteration,
+    // per recorded node.
+    double tape_bytes_per_node(int width){
+        const std::size_t live_before = g_live_bytes;
+        tape::Tape t(0);
+        std::vector<tape::Var> ws;
+        for(int i=0; i<width; ++i){
+            ws.push_back(t.leaf(0.01*(i%7)));
+        }
+        auto out = t.leaf(0.1);
+        for(int i=0; i<width; ++i){
+            out = out + ws[i] * t.leaf(0.02*(i%5));
+        }
+        out = out.tanh();
+        return static_cast<double>(g_live_bytes - live_before) / t.size();
+    }
+
+    Result bench_tape_engine(int width, int iters){
+        tape::Tape t;
+        std::vector<tape::Var> ws;
+        for(int i=0; i<width; ++i){
+            ws.push_back(t.leaf(0.01*(i%7)));
+        }
+        auto b = t.leaf(0.1);
+        t.freeze();
+        const double nodes = 3.0*width + 1;
+
+        double build_time = 0.0, backward_time = 0.0;
+        std::size_t allocs_before = g_alloc_count;
+        for(int it=0; it<iters; ++it){
+            auto start = clock_type::now();
+            auto out = b;
+            for(int i=0; i<width; ++i){
+                auto x = t.leaf(0.02*(i%5));
+                out = out + ws[i] * x;
+            }
+            out = out.tanh();
+            build_time += seconds_since(start);
+
+            start = clock_type::now();
+            out.backward();
+            backward_time += seconds_since(start);
+
+            t.zero_grad();
+            t.reset();
+        }
+        return {nodes*iters/build_time, nodes*iters/backward_time,
+                tape_bytes_per_node(width),
+                (g_alloc_count - allocs_before)/(nodes*iters)};
+    }
+
+    void print_row(const char* engine, int width, const Result& r){
+        std::printf("%-8s %8d %16.3e %16.3e %14.1f %14.4f\n",
+                    engine, width, r.build_nodes_per_sec, r.backward_nodes_per_sec, r.bytes_per_node, r.allocs_per_node);
+    }
+}
+
+int main(){
+    std::printf("%-8s %8s %16s %16s %14s %14s\n", "engine", "width", "build nodes/s", "bwd nodes/s", "bytes/node", "allocs/node");
+    for(int width : {16, 256, 4096}){
+        int iters = 1000000 / width;
+        print_row("value", width, bench_value_engine(width, iters));
+        print_row("tape", width, bench_tape_engine(width, iters));
+    }
+    return 0;
+}
@@ -8,28 +8,118 @@
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <cstdint>
+#include <atomic>
+#include <utility>
+#include <cassert>
 
 #include <iostream>
 
+#include "op.h"
+#include "profile.h"
+
 namespace micrograd{
 
-    class Value : public std::enable_shared_from_this<Value>{
+    //=====================================================================================================================
+    // Value
+    //
+    // A scalar node of the autograd graph, templated on the scalar type T. Value (double) and Valuef (float)
+    // are the two instantiations in use; see the aliases at the end of this file.
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicValue : public std::enable_shared_from_this<BasicValue<T>>{
         public:
-            static int nVals;
-            double data;
-            double grad;
-            std::set<std::shared_ptr<Value>> prevs;
-            std::string op;
-            std::string label;
+            using scalar_type = T;
+
+            // Number of live Value nodes (across all threads).
+            inline static std::atomic<int> nVals{0};
+            T data;
+            T grad;
+            // Constant operand of AddConst, MulConst, Pow and PowBase.
+            T aux;
+            Op op;
+            // Scratch index for passes over a whole graph (the parallel backward scheduler numbers the nodes
+            // of a topological order with it). Meaningless outside such a pass.
+            std::uint32_t pass_index = 0;
+            // Operands in order; x*x lists x twice.
+            std::vector<std::shared_ptr<BasicValue>> prevs;
+            // Only used by nodes whose op is not a built-in scalar op (see propagate_forward/propagate_backward).
             std::function<void()> back_prop;
+            // Recomputes data from the prevs' current data. Used to replay a captured graph.
+            std::function<void()> forward_prop;
+
+            BasicValue(T data = T(0), Op op = Op::None, std::vector<std::shared_ptr<BasicValue>> children = {}, T aux = T(0))
+                : data(data), grad(T(0)), aux(aux), op(op), prevs(std::move(children)) {
+                [[maybe_unused]] const int live = ++nVals;
+                MICROGRAD_PROFILE_NODE(op, sizeof(BasicValue) + prevs.capacity()*sizeof(std::shared_ptr<BasicValue>), live);
+            }
+
+            BasicValue(T data, std::string label)
+                : BasicValue(data){
+                set_label(std::move(label));
+            }
 
-            Value(double data, std::set<std::shared_ptr<Value>> children = {}, std::string op = "", std::string label="")
-                : data(data), prevs(children), op(op), grad(0.0), label(label) {
-                back_prop = [](){};
+            // Original constructor, kept for existing callers. A node built this way with children is driven
+            // by the closures the caller assigns; the op string is no longer stored.
+            BasicValue(T data, const std::set<std::shared_ptr<BasicValue>>& children, const std::string& op = "", const std::string& label="")
+                : BasicValue(data, children.empty() ? Op::None : Op::Custom, std::vector<std::shared_ptr<BasicValue>>(children.begin(), children.end())) {
+                (void)op;
+                if(!label.empty()) set_label(label);
+            }
+
+            // Closures only hold raw pointers to their output and operands; ownership of the graph flows
+            // strictly from a node to its prevs. The default member-wise teardown would recurse once per
+            // node, so children that are about to die are unlinked here, iteratively.
+            virtual ~BasicValue(){
+                --nVals;
+                std::vector<std::shared_ptr<BasicValue>> pending = std::move(prevs);
+                prevs.clear();
+                while(!pending.empty()){
+                    std::shared_ptr<BasicValue> node = std::move(pending.back());
+                    pending.pop_back();
+                    if(node.use_count() == 1){
+                        for(auto& child : node->prevs){
+                            pending.push_back(std::move(child));
+                        }
+                        node->prevs.clear();
+                    }
+                }
             }
             
+            // Resets the gradient before a backward sweep. Nodes that carry more than one scalar override this.
+            virtual void zero_grad(){
+                grad = T(0);
+            }
+
+            //=====================================================================================================================
+            // Labels
+            //
+            // Labels are only read by the visualizer, so they are allocated on demand: a node without an explicit
+            // label carries a null pointer. Op labels, including constant operands, are formatted when asked for.
+            //=====================================================================================================================
+
+            const std::string& label() const{
+                static const std::string empty;
+                return label_ ? *label_ : empty;
+            }
+
+            void set_label(std::string label){
+                label_.reset(new std::string(std::move(label)));
+            }
+
+            std::string op_label() const{
+                std::string name = op_name(op);
+                if(op == Op::AddConst || op == Op::MulConst || op == Op::Pow || op == Op::PowBase){
+                    std::ostringstream label_stream;
+                    label_stream << std::fixed << std::setprecision(2) << aux;
+                    name += (op == Op::PowBase) ? " (base " + label_stream.str() + ")" : " " + label_stream.str();
+                }
+                return name;
+            }
+
             std::string repr() const {
-                return "Value(data = "+std::to_string(data)+" | grad = " + std::to_string(grad) + " label: "+ label+ ")";
+                return "Value(data = "+std::to_string(data)+" | grad = " + std::to_string(grad) + " label: "+ label()+ ")";
             }
 
             //=====================================================================================================================
@@ -40,31 +130,17 @@ namespace micrograd{
             // 3. double + Value
             //=====================================================================================================================
 
-            std::shared_ptr<Value> operator+(Value& other) {
-                auto other_ptr = other.shared_from_this();
-                auto output = std::make_shared<Value>(data + other.data, std::set<std::shared_ptr<Value>>{shared_from_this(), other_ptr}, "+", "");//"("+label+"+"+other.label+")");
-                output->back_prop = [this, other_ptr, output](){
-                    this->grad += 1.0 * output->grad;
-                    other_ptr->grad += 1.0 * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> operator+(BasicValue& other) {
+                return std::make_shared<BasicValue>(data + other.data, Op::Add, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this(), other.shared_from_this()});
             }
 
-            std::shared_ptr<Value> operator+(double other) {
-                std::set<std::shared_ptr<Value>> init = {};
-                std::ostringstream label_stream;
-                label_stream << std::fixed << std::setprecision(2) <<other;
-                std::string dlabel = label_stream.str();
-                auto other_ptr = std::make_shared<Value>(other, init, "", dlabel);
-                auto output = std::make_shared<Value>(data + other, std::set<std::shared_ptr<Value>>{shared_from_this(), other_ptr}, "+", "");//"("+label+"+"+other_ptr->label+")");
-                output->back_prop = [this, other_ptr, output](){
-                    this->grad += 1.0 * output->grad;
-                    other_ptr->grad += 1.0 * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> operator+(T other) {
+                return std::make_shared<BasicValue>(data + other, Op::AddConst, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this()}, other);
             }
 
-            friend inline std::shared_ptr<Value> operator+(double lhs, Value& rhs);
+            friend std::shared_ptr<BasicValue> operator+(T lhs, BasicValue& rhs){
+                return std::make_shared<BasicValue>(lhs + rhs.data, Op::AddConst, std::vector<std::shared_ptr<BasicValue>>{rhs.shared_from_this()}, lhs);
+            }
 
             //=====================================================================================================================
             // (-) operation
@@ -74,17 +150,20 @@ namespace micrograd{
             // 3. double - Value
             //=====================================================================================================================
 
-            std::shared_ptr<Value> operator-(Value& other) {
-                auto negated = -1.0 * other;
+            std::shared_ptr<BasicValue> operator-(BasicValue& other) {
+                auto negated = T(-1) * other;
                 return ((*this) + (*negated));
             }
 
-            std::shared_ptr<Value> operator-(double other) {
-                auto negated = -1.0 * other;
+            std::shared_ptr<BasicValue> operator-(T other) {
+                auto negated = T(-1) * other;
                 return ((*this) + (negated));
             }
 
-            friend inline std::shared_ptr<Value> operator-(double lhs, Value& rhs);
+            friend std::shared_ptr<BasicValue> operator-(T lhs, BasicValue& rhs){
+                auto negated = T(-1) * rhs;
+                return (lhs + (*negated));
+            }
 
             //=====================================================================================================================
             // (*) operation
@@ -94,31 +173,17 @@ namespace micrograd{
             // 3. double * Value
             //=====================================================================================================================
 
-            std::shared_ptr<Value> operator*(Value& other) {
-                auto other_ptr = other.shared_from_this();
-                auto output = std::make_shared<Value>(data * other_ptr->data, std::set<std::shared_ptr<Value>>{shared_from_this(), other_ptr}, "*", "");//"("+label+"*"+other.label+")");
-                output->back_prop = [this, other_ptr, output](){
-                    this->grad += other_ptr->data * output->grad;
-                    other_ptr->grad += this->data * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> operator*(BasicValue& other) {
+                return std::make_shared<BasicValue>(data * other.data, Op::Mul, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this(), other.shared_from_this()});
             }
 
-            std::shared_ptr<Value> operator*(double other) {
-                std::set<std::shared_ptr<Value>> init = {};
-                std::ostringstream label_stream;
-                label_stream << std::fixed << std::setprecision(2) <<other;
-                std::string dlabel = label_stream.str();
-                auto other_ptr = std::make_shared<Value>(other, init, "", dlabel);
-                auto output = std::make_shared<Value>(data * other, std::set<std::shared_ptr<Value>>{shared_from_this(), other_ptr}, "*", "");//"("+label+"*"+other_ptr->label+")");
-                output->back_prop = [this, other_ptr, output](){
-                    this->grad += other_ptr->data * output->grad;
-                    other_ptr->grad += this->data * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> operator*(T other) {
+                return std::make_shared<BasicValue>(data * other, Op::MulConst, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this()}, other);
             }
 
-            friend inline std::shared_ptr<Value> operator*(double lhs, Value& rhs);
+            friend std::shared_ptr<BasicValue> operator*(T lhs, BasicValue& rhs){
+                return std::make_shared<BasicValue>(lhs * rhs.data, Op::MulConst, std::vector<std::shared_ptr<BasicValue>>{rhs.shared_from_this()}, lhs);
+            }
 
             //=====================================================================================================================
             // (/) operation
@@ -128,17 +193,20 @@ namespace micrograd{
             // 3. double / Value
             //=====================================================================================================================
 
-            std::shared_ptr<Value> operator/(Value& other) {
-                auto div = other.pow(-1.0);
+            std::shared_ptr<BasicValue> operator/(BasicValue& other) {
+                auto div = other.pow(T(-1));
                 return ((*this) * (*div));
             }
 
-            std::shared_ptr<Value> operator/(double other) {
-                auto div = std::pow(other, -1.0);
+            std::shared_ptr<BasicValue> operator/(T other) {
+                auto div = std::pow(other, T(-1));
                 return ((*this) * (div));
             }
 
-            friend inline std::shared_ptr<Value> operator/(double lhs, Value& rhs);
+            friend std::shared_ptr<BasicValue> operator/(T lhs, BasicValue& rhs){
+                auto div = rhs.pow(T(-1));
+                return (lhs * (*div));
+            }
 
             //=====================================================================================================================
             // (pow) operation
@@ -148,32 +216,13 @@ namespace micrograd{
             //=====================================================================================================================
             
             // y = x^a, where x is the variable currently being handled. a is the double value.
-            std::shared_ptr<Value> pow(double other){
-                std::set<std::shared_ptr<Value>> init = {};
-                std::ostringstream label_stream;
-                label_stream << std::fixed << std::setprecision(2) <<other;
-                std::string dlabel = label_stream.str();
-                auto other_ptr = std::make_shared<Value>(other, init, "", dlabel);
-                auto output = std::make_shared<Value>(std::pow(data, other), std::set<std::shared_ptr<Value>>{shared_from_this(), other_ptr}, "^", "");//"("+label+"^"+other_ptr->label+")");
-                output->back_prop = [this, other_ptr, output](){
-                    this->grad += (other_ptr->data * std::pow(this->data, other_ptr->data - 1)) * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> pow(T other){
+                return std::make_shared<BasicValue>(std::pow(data, other), Op::Pow, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this()}, other);
             }
 
             // y = a^x, where a is the double value. x is the variable currently being handled.
-            std::shared_ptr<Value> pow_with_base(double other){
-                std::set<std::shared_ptr<Value>> init = {};
-                std::ostringstream label_stream;
-                label_stream << std::fixed << std::setprecision(2) <<other;
-                std::string dlabel = label_stream.str();
-                auto other_ptr = std::make_shared<Value>(other, init, "", dlabel);
-                auto output = std::make_shared<Value>(std::pow(other, data), std::set<std::shared_ptr<Value>>{other_ptr, shared_from_this()}, "^", "");//"("+other_ptr->label+"^"+label+")");
-                output->back_prop = [this, other_ptr, output](){
-                    // y = a^x => y' = a^x * ln(a)
-                    this->grad += (std::pow(other_ptr->data, this->data) * std::log(other_ptr->data)) * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> pow_with_base(T other){
+                return std::make_shared<BasicValue>(std::pow(other, data), Op::PowBase, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this()}, other);
             }
 
             //=====================================================================================================================
@@ -182,13 +231,8 @@ namespace micrograd{
             // 1. exp(Value)
             //=====================================================================================================================
 
-            std::shared_ptr<Value> exp(){
-                double t = std::exp(data);
-                auto output = std::make_shared<Value>(t, std::set<std::shared_ptr<Value>>{shared_from_this()}, "exp", "");//"exp_("+label+")");
-                output->back_prop = [this, t, output](){
-                    this->grad += t * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> exp(){
+                return std::make_shared<BasicValue>(std::exp(data), Op::Exp, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this()});
             }
 
             //=====================================================================================================================
@@ -197,13 +241,237 @@ namespace micrograd{
             // 1. tanh(Value)
             //=====================================================================================================================
 
-            std::shared_ptr<Value> tanh(){
-                double t = (std::exp(2*data) - 1) / (std::exp(2*data) + 1);
-                auto output = std::make_shared<Value>(t, std::set<std::shared_ptr<Value>>{shared_from_this()}, "tanh", "");//"tanh_("+label+")");
-                output->back_prop = [this, t, output](){
-                    this->grad += (1 - t*t) * output->grad;
-                };
-                return output;
+            std::shared_ptr<BasicValue> tanh(){
+                T t = (std::exp(2*data) - 1) / (std::exp(2*data) + 1);
+                return std::make_shared<BasicValue>(t, Op::Tanh, std::vector<std::shared_ptr<BasicValue>>{this->shared_from_this()});
+            }
+
+            //=====================================================================================================================
+            // Per-node steps
+            //
+            // propagate_forward() recomputes data from the prevs' current data; propagate_backward() adds this
+            // node's contribution to the prevs' gradients. Built-in scalar ops are a switch on op, anything else
+            // runs its closures.
+            //=====================================================================================================================
+
+            void propagate_forward(){
+                switch(op){
+                    case Op::None:
+                        break;
+                    case Op::Add:
+                        data = prevs[0]->data + prevs[1]->data;
+                        break;
+                    case Op::AddConst:
+                        data = prevs[0]->data + aux;
+                        break;
+                    case Op::Mul:
+                        data = prevs[0]->data * prevs[1]->data;
+                        break;
+                    case Op::MulConst:
+                        data = prevs[0]->data * aux;
+                        break;
+                    case Op::Pow:
+                        data = std::pow(prevs[0]->data, aux);
+                        break;
+                    case Op::PowBase:
+                        data = std::pow(aux, prevs[0]->data);
+                        break;
+                    case Op::Exp:
+                        data = std::exp(prevs[0]->data);
+                        break;
+                    case Op::Tanh:{
+                        const T x = prevs[0]->data;
+                        data = (std::exp(2*x) - 1) / (std::exp(2*x) + 1);
+                        break;
+                    }
+                    case Op::Linear:
+                    case Op::LinearTanh:{
+                        // Same summation order as the chain b + w0*x0 + w1*x1 + ... it replaces.
+                        const std::size_t n = prevs.size() / 2;
+                        const std::shared_ptr<BasicValue>* w = prevs.data();
+                        const std::shared_ptr<BasicValue>* x = w + n;
+                        T z = prevs.back()->data;
+                        for(std::size_t i=0; i<n; ++i){
+                            z = z + w[i]->data * x[i]->data;
+                        }
+                        data = (op == Op::LinearTanh) ? (std::exp(2*z) - 1) / (std::exp(2*z) + 1) : z;
+                        break;
+                    }
+                    case Op::Sum:
+                    case Op::Mean:{
+                        T s = prevs[0]->data;
+                        for(std::size_t i=1; i<prevs.size(); ++i){
+                            s = s + prevs[i]->data;
+                        }
+                        data = (op == Op::Mean) ? s / static_cast<T>(prevs.size()) : s;
+                        break;
+                    }
+                    case Op::Mse:{
+                        const std::size_t n = prevs.size() / 2;
+                        T s = T(0);
+                        for(std::size_t i=0; i<n; ++i){
+                            const T d = prevs[i]->data - prevs[n + i]->data;
+                            s = s + d*d;
+                        }
+                        data = s / static_cast<T>(n);
+                        break;
+                    }
+                    default:
+                        if(forward_prop) forward_prop();
+                        break;
+                }
+            }
+
+            void propagate_backward(){
+                switch(op){
+                    case Op::None:
+                        break;
+                    case Op::Add:
+                        prevs[0]->grad += T(1) * grad;
+                        prevs[1]->grad += T(1) * grad;
+                        break;
+                    case Op::AddConst:
+                        prevs[0]->grad += T(1) * grad;
+                        break;
+                    case Op::Mul:
+                        prevs[0]->grad += prevs[1]->data * grad;
+                        prevs[1]->grad += prevs[0]->data * grad;
+                        break;
+                    case Op::MulConst:
+                        prevs[0]->grad += aux * grad;
+                        break;
+                    case Op::Pow:
+                        prevs[0]->grad += (aux * std::pow(prevs[0]->data, aux - 1)) * grad;
+                        break;
+                    case Op::PowBase:
+                        // y = a^x => y' = a^x * ln(a)
+                        prevs[0]->grad += (std::pow(aux, prevs[0]->data) * std::log(aux)) * grad;
+                        break;
+                    case Op::Exp:
+                        prevs[0]->grad += data * grad;
+                        break;
+                    case Op::Tanh:
+                        prevs[0]->grad += (1 - data*data) * grad;
+                        break;
+                    case Op::Linear:
+                    case Op::LinearTanh:{
+                        const std::size_t n = prevs.size() / 2;
+                        const std::shared_ptr<BasicValue>* w = prevs.data();
+                        const std::shared_ptr<BasicValue>* x = w + n;
+                        const T dz = (op == Op::LinearTanh) ? (1 - data*data) * grad : grad;
+                        prevs.back()->grad += T(1) * dz;
+                        for(std::size_t i=0; i<n; ++i){
+                            w[i]->grad += x[i]->data * dz;
+                            x[i]->grad += w[i]->data * dz;
+                        }
+                        break;
+                    }
+                    case Op::Sum:
+                        for(const auto& p : prevs){
+                            p->grad += grad;
+                        }
+                        break;
+                    case Op::Mean:{
+                        const T g = grad / static_cast<T>(prevs.size());
+                        for(const auto& p : prevs){
+                            p->grad += g;
+                        }
+                        break;
+                    }
+                    case Op::Mse:{
+                        const std::size_t n = prevs.size() / 2;
+                        const T c = T(2) * grad / static_cast<T>(n);
+                        for(std::size_t i=0; i<n; ++i){
+                            const T d = c * (prevs[i]->data - prevs[n + i]->data);
+                            prevs[i]->grad += d;
+                            prevs[n + i]->grad -= d;
+                        }
+                        break;
+                    }
+                    default:
+                        if(back_prop) back_prop();
+                        break;
+                }
+            }
+
+            // The share of propagate_backward() that goes to operand `slot`, added to g with the same operations.
+            // Pulling every slot's share in for_each_backward_slot() order gives each prev exactly the gradient
+            // propagate_backward() would have pushed into it. Built-in scalar ops only.
+            void accumulate_into(T& g, std::size_t slot) const{
+                switch(op){
+                    case Op::Add:
+                    case Op::AddConst:
+                        g += T(1) * grad;
+                        break;
+                    case Op::Mul:
+                        g += prevs[1 - slot]->data * grad;
+                        break;
+                    case Op::MulConst:
+                        g += aux * grad;
+                        break;
+                    case Op::Pow:
+                        g += (aux * std::pow(prevs[0]->data, aux - 1)) * grad;
+                        break;
+                    case Op::PowBase:
+                        g += (std::pow(aux, prevs[0]->data) * std::log(aux)) * grad;
+                        break;
+                    case Op::Exp:
+                        g += data * grad;
+                        break;
+                    case Op::Tanh:
+                        g += (1 - data*data) * grad;
+                        break;
+                    case Op::Linear:
+                    case Op::LinearTanh:{
+                        const std::size_t n = prevs.size() / 2;
+                        const T dz = (op == Op::LinearTanh) ? (1 - data*data) * grad : grad;
+                        if(slot == 2*n) g += T(1) * dz;
+                        else if(slot < n) g += prevs[n + slot]->data * dz;
+                        else g += prevs[slot - n]->data * dz;
+                        break;
+                    }
+                    case Op::Sum:
+                        g += grad;
+                        break;
+                    case Op::Mean:
+                        g += grad / static_cast<T>(prevs.size());
+                        break;
+                    case Op::Mse:{
+                        const std::size_t n = prevs.size() / 2;
+                        const std::size_t i = slot < n ? slot : slot - n;
+                        const T c = T(2) * grad / static_cast<T>(n);
+                        const T d = c * (prevs[i]->data - prevs[n + i]->data);
+                        if(slot < n) g += d;
+                        else g -= d;
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            // Calls fn(slot) for every operand slot, in the order propagate_backward() updates them.
+            template<typename Fn>
+            void for_each_backward_slot(Fn&& fn) const{
+                const std::size_t size = prevs.size();
+                if(op == Op::Linear || op == Op::LinearTanh){
+                    const std::size_t n = size / 2;
+                    fn(size - 1);
+                    for(std::size_t i=0; i<n; ++i){
+                        fn(i);
+                        fn(n + i);
+                    }
+                } else if(op == Op::Mse){
+                    const std::size_t n = size / 2;
+                    for(std::size_t i=0; i<n; ++i){
+                        fn(i);
+                        fn(n + i);
+                    }
+                } else{
+                    for(std::size_t slot=0; slot<size; ++slot){
+                        fn(slot);
+                    }
+                }
             }
 
             //=====================================================================================================================
@@ -211,77 +479,214 @@ namespace micrograd{
             // 
             // How to use:
             // First build the expressions in order
-            // e.g. std::set<std::shared_ptr<Value>> init = {};
-            //      auto x1 = std::make_shared<Value>(2.0, init, "", "x1");
-            //      auto w1 = std::make_shared<Value>(-3.0, init, "", "w1");
+            // e.g. auto x1 = std::make_shared<Value>(2.0, "x1");
+            //      auto w1 = std::make_shared<Value>(-3.0, "w1");
             //      auto y = (*x1) * (*w1)
             // Then, call backward() at the last value of the expression tree.
             // e.g. y.backward()
+            //
+            // With retain_graph = false the graph is released while the gradients are propagated: once a node
+            // has run its backward step it drops its prevs, so every intermediate node is freed as soon as nothing
+            // upstream needs it any more. Only leaves (and nodes still held elsewhere, now detached) survive.
+            // Leaves are left untouched. Other roots that share the released nodes rebuild their topological
+            // order on next use; roots of unrelated graphs keep theirs.
             //=====================================================================================================================
 
-            void backward(){
-                std::vector<std::shared_ptr<Value>> topo;
-                std::set<std::shared_ptr<Value>> visited;
-
-                build_topo(shared_from_this(), topo, visited);
+            void backward(bool retain_graph = true){
+                const std::vector<BasicValue*>& topo = topological_order();
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Backward);
 
+                // Interior gradients are rebuilt from scratch on every call, so the graph (and its cached order)
+                // can be backpropagated again. Leaves keep accumulating as before.
+                for(BasicValue* node : topo){
+                    if(!node->prevs.empty()) node->zero_grad();
+                }
                 this->grad = 1.0;
-                for(auto it = topo.rbegin(); it!=topo.rend(); ++it){
-                    (*it)->back_prop();
+
+                if(retain_graph){
+                    for(auto it = topo.rbegin(); it!=topo.rend(); ++it){
+                        (*it)->propagate_backward();
+                    }
+                    return;
+                }
+
+                // Hold every node for the duration of the sweep: a node may only be freed after its own
+                // backward step has run, not when the last of its parents lets go of it.
+                auto self = this->shared_from_this();
+                std::vector<std::shared_ptr<BasicValue>> owned;
+                owned.reserve(topo.size());
+                for(BasicValue* node : topo){
+                    owned.push_back(node->shared_from_this());
+                }
+                invalidate_topo();
+
+                for(auto it = owned.rbegin(); it!=owned.rend(); ++it){
+                    BasicValue* node = it->get();
+                    node->propagate_backward();
+                    if(!node->prevs.empty()) node->detach();
+                    it->reset();
                 }
             }
 
+            // Detaches the node from its inputs; from now on it behaves as a leaf. Roots whose cached
+            // topological order reaches this node rebuild it on next use.
+            void release(){
+                detach();
+            }
+
+            //=====================================================================================================================
+            // Topological ordering
+            //
+            // The order of the graph rooted at this node is built once, iteratively, and cached on the node.
+            // The ops themselves never change a node's prevs, but release() (and backward(false), which
+            // releases the nodes it visits) clears them, possibly on nodes shared with other roots. A released
+            // node is stamped with the time of its release, and a cached order that holds a node released after
+            // the order was built is rebuilt, so an order never holds a pointer to a node that has since been
+            // freed. Releasing an unrelated graph leaves the cache alone. Call invalidate_topo() after editing
+            // prevs by hand.
+            //=====================================================================================================================
+
+            const std::vector<BasicValue*>& topological_order(){
+                if(!topo_cache || topo_cache_stale()){
+                    MICROGRAD_PROFILE_SCOPE(profile::Phase::BuildTopo);
+                    topo_cache.reset(new TopoCache{next_epoch(), {}});
+                    build_topo(topo_cache->order);
+                }
+                return topo_cache->order;
+            }
+
+            void invalidate_topo(){
+                topo_cache.reset();
+            }
+
 
         private:
-            void build_topo(const std::shared_ptr<Value>& node, 
-                            std::vector<std::shared_ptr<Value>>& topo, 
-                            std::set<std::shared_ptr<Value>> &visited){
-                if(visited.find(node) == visited.end()){
-                    visited.insert(node);
-                    for(const auto& child : node->prevs){
-                        build_topo(child, topo, visited);
+            std::unique_ptr<std::string> label_;
+
+            // Visited mark for build_topo. A node counts as visited when its mark equals the epoch of the
+            // traversal in progress, so starting a new traversal never has to clear the marks of an old one.
+            std::uint64_t visit_epoch = 0;
+
+            // next_epoch() when the node was last detached from its prevs, 0 if never.
+            std::uint64_t release_epoch = 0;
+
+            struct TopoCache{
+                std::uint64_t built;            // next_epoch() just before the order was built
+                std::vector<BasicValue*> order;
+            };
+            std::unique_ptr<TopoCache> topo_cache;
+
+            // Whether a node of the cached order was released after it was built. The walk starts at the root:
+            // every parent of a node comes before it and was found unreleased, so it still holds the node, and
+            // the walk never touches a freed node even when a release freed part of the graph.
+            bool topo_cache_stale() const{
+                const std::vector<BasicValue*>& order = topo_cache->order;
+                for(auto it = order.rbegin(); it!=order.rend(); ++it){
+                    if((*it)->release_epoch > topo_cache->built) return true;
+                }
+                return false;
+            }
+
+            void detach(){
+                release_epoch = next_epoch();
+                op = Op::None;
+                back_prop = nullptr;
+                forward_prop = nullptr;
+                prevs.clear();
+                invalidate_topo();
+            }
+
+            static std::uint64_t next_epoch(){
+                static std::atomic<std::uint64_t> epoch{0};
+                return ++epoch;
+            }
+
+            // Iterative post-order DFS, equivalent to the recursive version but bounded by heap rather than
+            // stack, so chains of millions of nodes are fine.
+            void build_topo(std::vector<BasicValue*>& topo){
+                const std::uint64_t epoch = next_epoch();
+                std::vector<std::pair<BasicValue*, std::size_t>> stack;
+
+                this->visit_epoch = epoch;
+                stack.emplace_back(this, 0);
+                while(!stack.empty()){
+                    BasicValue* node = stack.back().first;
+                    std::size_t& next = stack.back().second;
+                    if(next < node->prevs.size()){
+                        BasicValue* child = node->prevs[next++].get();
+                        if(child->visit_epoch != epoch){
+                            child->visit_epoch = epoch;
+                            stack.emplace_back(child, 0);
+                        }
+                    } else{
+                        topo.push_back(node);
+                        stack.pop_back();
                     }
-                    topo.push_back(node);
                 }
             }
     };
 
 
-    std::shared_ptr<Value> operator+(double lhs, Value& rhs){
-        std::set<std::shared_ptr<Value>> init = {};
-        std::ostringstream label_stream;
-        label_stream << std::fixed << std::setprecision(2) <<lhs;
-        std::string dlabel = label_stream.str();
-        auto lhs_ptr = std::make_shared<Value>(lhs, init, "", dlabel);
-        auto output = std::make_shared<Value>(lhs + rhs.data, std::set<std::shared_ptr<Value>>{lhs_ptr, rhs.shared_from_this()}, "+", "");//"("+lhs_ptr->label+"+"+rhs.label+")");
-        output->back_prop = [lhs_ptr, &rhs, output](){
-            lhs_ptr->grad += 1.0 * output->grad;
-            rhs.grad += 1.0 * output->grad;
-        };
-        return output;
+    //=====================================================================================================================
+    // Fused n-ary ops
+    //
+    // Each is a single graph node over all of its operands, however many there are, with a backward step that
+    // writes every operand's gradient in one pass. They give the same values as the equivalent chains of
+    // binary ops, summed in the same order.
+    //
+    // 1. linear(ws, xs, b)        => b + w0*x0 + w1*x1 + ...          (optionally followed by tanh)
+    // 2. sum(xs), mean(xs)
+    // 3. mse(preds, targets)      => mean of (pred - target)^2
+    //=====================================================================================================================
+
+    enum class Activation : std::uint8_t{
+        None,
+        Tanh
+    };
+
+    namespace detail{
+        template<typename T>
+        std::shared_ptr<BasicValue<T>> make_nary(Op op, std::vector<std::shared_ptr<BasicValue<T>>> operands){
+            auto output = std::make_shared<BasicValue<T>>(T(0), op, std::move(operands));
+            output->propagate_forward();
+            return output;
+        }
     }
 
-    std::shared_ptr<Value> operator-(double lhs, Value& rhs){
-        auto negated = -1.0 * rhs;
-        return (lhs + (*negated));
+    template<typename T>
+    std::shared_ptr<BasicValue<T>> linear(const std::vector<std::shared_ptr<BasicValue<T>>>& ws, const std::vector<std::shared_ptr<BasicValue<T>>>& xs,
+                                          const std::shared_ptr<BasicValue<T>>& b, Activation act = Activation::None){
+        assert(("weights and inputs must have the same size", ws.size() == xs.size()));
+        std::vector<std::shared_ptr<BasicValue<T>>> operands;
+        operands.reserve(2*ws.size() + 1);
+        operands.insert(operands.end(), ws.begin(), ws.end());
+        operands.insert(operands.end(), xs.begin(), xs.end());
+        operands.push_back(b);
+        return detail::make_nary<T>(act == Activation::Tanh ? Op::LinearTanh : Op::Linear, std::move(operands));
     }
 
-    std::shared_ptr<Value> operator*(double lhs, Value& rhs){
-        std::set<std::shared_ptr<Value>> init = {};
-        std::ostringstream label_stream;
-        label_stream << std::fixed << std::setprecision(2) <<lhs;
-        std::string dlabel = label_stream.str();
-        auto lhs_ptr = std::make_shared<Value>(lhs, init, "", dlabel);
-        auto output = std::make_shared<Value>(lhs * rhs.data, std::set<std::shared_ptr<Value>>{lhs_ptr, rhs.shared_from_this()}, "*", "");//"("+lhs_ptr->label+"*"+rhs.label+")");
-        output->back_prop = [lhs_ptr, &rhs, output](){
-            lhs_ptr->grad += rhs.data * output->grad;
-            rhs.grad += lhs_ptr->data * output->grad;
-        };
-        return output;
+    template<typename T>
+    std::shared_ptr<BasicValue<T>> sum(const std::vector<std::shared_ptr<BasicValue<T>>>& xs){
+        assert(("sum of an empty list", !xs.empty()));
+        return detail::make_nary<T>(Op::Sum, xs);
     }
 
-    std::shared_ptr<Value> operator/(double lhs, Value& rhs){
-        auto div = rhs.pow(-1.0);
-        return (lhs * (*div));
+    template<typename T>
+    std::shared_ptr<BasicValue<T>> mean(const std::vector<std::shared_ptr<BasicValue<T>>>& xs){
+        assert(("mean of an empty list", !xs.empty()));
+        return detail::make_nary<T>(Op::Mean, xs);
     }
-}
\ No newline at end of file
+
+    template<typename T>
+    std::shared_ptr<BasicValue<T>> mse(const std::vector<std::shared_ptr<BasicValue<T>>>& preds, const std::vector<std::shared_ptr<BasicValue<T>>>& targets){
+        assert(("predictions and targets must have the same, non-zero size", preds.size() == targets.size() && !preds.empty()));
+        std::vector<std::shared_ptr<BasicValue<T>>> operands;
+        operands.reserve(2*preds.size());
+        operands.insert(operands.end(), preds.begin(), preds.end());
+        operands.insert(operands.end(), targets.begin(), targets.end());
+        return detail::make_nary<T>(Op::Mse, std::move(operands));
+    }
+
+    using Value = BasicValue<double>;
+    using Valuef = BasicValue<float>;
+}
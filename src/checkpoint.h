@@ -0,0 +1,300 @@
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nn.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Checkpoint format (version 1)
+    //
+    // All integers and doubles are stored in host byte order; the byte-order mark lets a reader on a different
+    // host reject the file instead of misreading it.
+    //
+    //      offset 0    Header                      magic "MGRDCKPT", version, byte-order mark, num_layers
+    //      offset 64   LayerRecord[num_layers]     num_in, num_out, byte offsets of the layer's W and b
+    //      ...         per layer, each 64-byte aligned:
+    //                      W   num_out x num_in doubles, row-major (row j = weights of neuron j)
+    //                      b   num_out doubles
+    //
+    // Every layer is a tanh layer, as in MLP.
+    //
+    // How to use:
+    //      save_checkpoint(mlp, "model.ckpt");
+    //
+    //      MLP restored = load_mlp("model.ckpt");          // trainable copy
+    //      MappedModel model("model.ckpt");                // inference straight from the mapped file
+    //      model.predict(x, y);
+    //=====================================================================================================================
+
+    namespace checkpoint{
+        constexpr char kMagic[8] = {'M', 'G', 'R', 'D', 'C', 'K', 'P', 'T'};
+        constexpr std::uint32_t kVersion = 1;
+        constexpr std::uint32_t kByteOrderMark = 0x01020304;
+        constexpr std::uint64_t kAlignment = 64;
+
+        struct Header{
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byte_order;
+            std::uint32_t num_layers;
+            std::uint32_t reserved0;
+            std::uint64_t file_size;
+            std::uint8_t reserved1[32];
+        };
+        static_assert(sizeof(Header) == kAlignment, "checkpoint header must fill exactly one aligned block");
+
+        struct LayerRecord{
+            std::uint32_t num_in;
+            std::uint32_t num_out;
+            std::uint64_t weight_offset;
+            std::uint64_t bias_offset;
+        };
+        static_assert(sizeof(LayerRecord) == 24, "unexpected LayerRecord padding");
+
+        inline std::uint64_t align_up(std::uint64_t offset){
+            return (offset + kAlignment - 1) / kAlignment * kAlignment;
+        }
+
+        // Lays out the records for the given shapes; returns the total file size.
+        inline std::uint64_t plan_layout(std::vector<LayerRecord>& records){
+            std::uint64_t offset = align_up(sizeof(Header) + records.size()*sizeof(LayerRecord));
+            for(auto& r : records){
+                r.weight_offset = offset;
+                offset = align_up(offset + std::uint64_t(r.num_out)*r.num_in*sizeof(double));
+                r.bias_offset = offset;
+                offset = align_up(offset + std::uint64_t(r.num_out)*sizeof(double));
+            }
+            return offset;
+        }
+
+        // True if [offset, offset + bytes) lies inside a file of size bytes. Written with subtractions so that
+        // offsets and lengths read from a crafted file cannot wrap around.
+        inline bool in_bounds(std::uint64_t offset, std::uint64_t bytes, std::uint64_t size){
+            return offset <= size && bytes <= size - offset;
+        }
+
+        // Checks the header and layer table of a checkpoint held in memory; throws on anything malformed.
+        inline void validate(const unsigned char* base, std::uint64_t size, const std::string& path){
+            if(size < sizeof(Header)) throw std::runtime_error("checkpoint " + path + ": file too small");
+            const Header* h = reinterpret_cast<const Header*>(base);
+            if(std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0) throw std::runtime_error("checkpoint " + path + ": bad magic");
+            if(h->byte_order != kByteOrderMark) throw std::runtime_error("checkpoint " + path + ": written on a host with a different byte order");
+            if(h->version != kVersion) throw std::runtime_error("checkpoint " + path + ": unsupported version " + std::to_string(h->version));
+            if(h->file_size != size) throw std::runtime_error("checkpoint " + path + ": truncated or trailing data");
+            const std::uint64_t table_end = sizeof(Header) + std::uint64_t(h->num_layers)*sizeof(LayerRecord);
+            if(h->num_layers == 0 || table_end > size){
+                throw std::runtime_error("checkpoint " + path + ": bad layer table");
+            }
+            const LayerRecord* records = reinterpret_cast<const LayerRecord*>(base + sizeof(Header));
+            for(std::uint32_t i=0; i<h->num_layers; ++i){
+                const LayerRecord& r = records[i];
+                // num_out * num_in * sizeof(double) can exceed 64 bits; bound num_in by what the file can hold first.
+                const bool shape_ok = r.num_in != 0 && r.num_out != 0 && (i == 0 || r.num_in == records[i-1].num_out) &&
+                                      r.num_in <= size / sizeof(double) / r.num_out;
+                if(!shape_ok || r.weight_offset % kAlignment || r.bias_offset % kAlignment ||
+                   r.weight_offset < table_end || r.bias_offset < table_end ||
+                   !in_bounds(r.weight_offset, std::uint64_t(r.num_out)*r.num_in*sizeof(double), size) ||
+                   !in_bounds(r.bias_offset, std::uint64_t(r.num_out)*sizeof(double), size)){
+                    throw std::runtime_error("checkpoint " + path + ": bad record for layer " + std::to_string(i));
+                }
+            }
+        }
+    }
+
+    // Writes the MLP's weights to path. Throws std::runtime_error if the file cannot be written.
+    inline void save_checkpoint(const MLP& mlp, const std::string& path){
+        using namespace checkpoint;
+        std::vector<LayerRecord> records;
+        for(const Layer& layer : mlp.layers){
+            records.push_back({static_cast<std::uint32_t>(layer.num_in), static_cast<std::uint32_t>(layer.num_out), 0, 0});
+        }
+        const std::uint64_t file_size = plan_layout(records);
+
+        std::vector<unsigned char> buffer(file_size, 0);
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byte_order = kByteOrderMark;
+        header.num_layers = static_cast<std::uint32_t>(records.size());
+        header.file_size = file_size;
+        std::memcpy(buffer.data(), &header, sizeof(header));
+        std::memcpy(buffer.data() + sizeof(Header), records.data(), records.size()*sizeof(LayerRecord));
+
+        for(size_t l=0; l<mlp.layers.size(); ++l){
+            const Layer& layer = mlp.layers[l];
+            double* W = reinterpret_cast<double*>(buffer.data() + records[l].weight_offset);
+            double* b = reinterpret_cast<double*>(buffer.data() + records[l].bias_offset);
+            for(size_t j=0; j<layer.neurons.size(); ++j){
+                const Neuron& neuron = layer.neurons[j];
+                for(size_t i=0; i<neuron.ws.size(); ++i){
+                    W[j*layer.num_in + i] = neuron.ws[i]->data;
+                }
+                b[j] = neuron.b->data;
+            }
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        if(!out) throw std::runtime_error("checkpoint " + path + ": write failed");
+    }
+
+    //=====================================================================================================================
+    // Memory-mapped model
+    //
+    // Maps a checkpoint read-only and evaluates straight from the mapped weights: nothing is copied or
+    // allocated per model, so startup cost is an open() and an mmap() regardless of model size, and workers
+    // that map the same file share its pages. predict() computes exactly what MLP::predict does, bit for bit.
+    //=====================================================================================================================
+
+    class MappedModel{
+        public:
+            struct LayerView{
+                std::size_t num_in;
+                std::size_t num_out;
+                const double* W;    // num_out x num_in, row-major
+                const double* b;    // num_out
+            };
+
+            std::vector<LayerView> layers;
+
+            explicit MappedModel(const std::string& path){
+                const int fd = ::open(path.c_str(), O_RDONLY);
+                if(fd < 0) throw std::runtime_error("checkpoint " + path + ": cannot open");
+                struct stat st;
+                if(::fstat(fd, &st) != 0 || st.st_size <= 0){
+                    ::close(fd);
+                    throw std::runtime_error("checkpoint " + path + ": cannot stat");
+                }
+                size = static_cast<std::size_t>(st.st_size);
+                void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if(mapped == MAP_FAILED) throw std::runtime_error("checkpoint " + path + ": mmap failed");
+                base = static_cast<const unsigned char*>(mapped);
+
+                try{
+                    checkpoint::validate(base, size, path);
+                } catch(...){
+                    ::munmap(const_cast<unsigned char*>(base), size);
+                    throw;
+                }
+
+                const auto* header = reinterpret_cast<const checkpoint::Header*>(base);
+                const auto* records = reinterpret_cast<const checkpoint::LayerRecord*>(base + sizeof(checkpoint::Header));
+                for(std::uint32_t i=0; i<header->num_layers; ++i){
+                    layers.push_back({records[i].num_in, records[i].num_out,
+                                      reinterpret_cast<const double*>(base + records[i].weight_offset),
+                                      reinterpret_cast<const double*>(base + records[i].bias_offset)});
+                }
+            }
+
+            ~MappedModel(){
+                if(base) ::munmap(const_cast<unsigned char*>(base), size);
+            }
+
+            MappedModel(const MappedModel&) = delete;
+            MappedModel& operator=(const MappedModel&) = delete;
+
+            MappedModel(MappedModel&& other) noexcept
+                : layers(std::move(other.layers)), base(other.base), size(other.size){
+                other.base = nullptr;
+                other.size = 0;
+            }
+
+            std::size_t num_in() const { return layers.front().num_in; }
+            std::size_t num_out() const { return layers.back().num_out; }
+
+            // Shapes in the form MLP's constructor takes, e.g. {3, 4, 1}.
+            std::vector<double> shape() const{
+                std::vector<double> s{static_cast<double>(num_in())};
+                for(const auto& l : layers) s.push_back(static_cast<double>(l.num_out));
+                return s;
+            }
+
+            // y receives num_out() values. Same operations in the same order as Neuron::predict.
+            void predict(const double* x, double* y) const{
+                static thread_local std::vector<double> a, b;
+                const double* input = x;
+                for(size_t l=0; l<layers.size(); ++l){
+                    const LayerView& layer = layers[l];
+                    double* output = y;
+                    if(l+1 < layers.size()){
+                        std::vector<double>& buf = (l % 2 == 0) ? a : b;
+                        buf.resize(layer.num_out);
+                        output = buf.data();
+                    }
+                    for(size_t j=0; j<layer.num_out; ++j){
+                        const double* w = layer.W + j*layer.num_in;
+                        double z = layer.b[j];
+                        for(size_t i=0; i<layer.num_in; ++i){
+                            z = z + w[i] * input[i];
+                        }
+                        output[j] = (std::exp(2*z) - 1) / (std::exp(2*z) + 1);
+                    }
+                    input = output;
+                }
+            }
+
+            std::vector<double> predict(const std::vector<double>& x) const{
+                assert(("input size must match the num_in of the first layer", x.size() == num_in()));
+                std::vector<double> y(num_out());
+                predict(x.data(), y.data());
+                return y;
+            }
+
+            // X is (n x num_in) row-major, Y is (n x num_out).
+            void predict(const double* X, size_t n, double* Y) const{
+                for(size_t r=0; r<n; ++r){
+                    predict(X + r*num_in(), Y + r*num_out());
+                }
+            }
+
+        private:
+            const unsigned char* base = nullptr;
+            std::size_t size = 0;
+    };
+
+    // Copies a checkpoint's weights into an existing MLP of the same shape.
+    inline void load_checkpoint(MLP& mlp, const MappedModel& model){
+        if(model.layers.size() != mlp.layers.size()) throw std::runtime_error("checkpoint: layer count does not match the MLP");
+        for(size_t l=0; l<mlp.layers.size(); ++l){
+            Layer& layer = mlp.layers[l];
+            const auto& view = model.layers[l];
+            if(view.num_in != static_cast<size_t>(layer.num_in) || view.num_out != static_cast<size_t>(layer.num_out)){
+                throw std::runtime_error("checkpoint: shape of layer " + std::to_string(l) + " does not match the MLP");
+            }
+            for(size_t j=0; j<view.num_out; ++j){
+                Neuron& neuron = layer.neurons[j];
+                for(size_t i=0; i<view.num_in; ++i){
+                    neuron.ws[i]->data = view.W[j*view.num_in + i];
+                }
+                neuron.b->data = view.b[j];
+            }
+        }
+    }
+
+    inline void load_checkpoint(MLP& mlp, const std::string& path){
+        load_checkpoint(mlp, MappedModel(path));
+    }
+
+    // Builds a trainable MLP from a checkpoint.
+    inline MLP load_mlp(const std::string& path){
+        MappedModel model(path);
+        MLP mlp(model.shape());
+        load_checkpoint(mlp, model);
+        return mlp;
+    }
+}
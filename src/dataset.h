@@ -0,0 +1,531 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "random.h"
+#include "tensor.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Datasets
+    //
+    // A Source streams samples (features, then targets) as floats; a DataLoader groups them into fixed-size
+    // mini-batches and prepares the next batch on a background thread while the current one is used.
+    // Memory stays flat in the dataset size: binary files are memory-mapped and shuffled through a
+    // pseudo-random permutation computed on the fly, CSV files are read in fixed chunks and shuffled through
+    // a bounded shuffle buffer.
+    //
+    // How to use:
+    //      BinaryDataset data("train.bin", /*shuffle=*/true);
+    //      DataLoader loader(data, 32);
+    //      for(int epoch=0; epoch<num_epochs; ++epoch){
+    //          loader.start_epoch();
+    //          Batch batch;
+    //          while(loader.next(batch)){
+    //              auto y_pred = mlp(batch.inputs());
+    //              ...
+    //          }
+    //      }
+    //=====================================================================================================================
+
+    class Source{
+        public:
+            virtual ~Source() = default;
+
+            virtual std::size_t num_features() const = 0;
+            virtual std::size_t num_targets() const = 0;
+
+            // Restarts the stream; epoch selects the shuffle order.
+            virtual void rewind(std::uint64_t epoch) = 0;
+
+            // Writes the next sample into x (num_features) and y (num_targets); false once the epoch is done.
+            virtual bool next(float* x, float* y) = 0;
+    };
+
+    namespace dataset_detail{
+        // Bijection on [0, n) from a 4-round Feistel network over the next even power of two, cycle-walking
+        // outputs that fall outside the range. O(1) memory however large n is.
+        class Permutation{
+            public:
+                Permutation(std::uint64_t n = 0, std::uint64_t seed = 0) : n(n){
+                    unsigned bits = 2;
+                    while(bits < 64 && (std::uint64_t(1) << bits) < n) bits += 2;
+                    half_bits = bits / 2;
+                    half_mask = (std::uint64_t(1) << half_bits) - 1;
+                    for(int r=0; r<4; ++r){
+                        keys[r] = splitmix64(seed + r);
+                    }
+                }
+
+                std::uint64_t operator()(std::uint64_t i) const{
+                    do{
+                        i = encrypt(i);
+                    } while(i >= n);
+                    return i;
+                }
+
+            private:
+                std::uint64_t n;
+                unsigned half_bits;
+                std::uint64_t half_mask;
+                std::uint64_t keys[4];
+
+                std::uint64_t encrypt(std::uint64_t x) const{
+                    std::uint64_t left = x >> half_bits, right = x & half_mask;
+                    for(int r=0; r<4; ++r){
+                        const std::uint64_t next = left ^ (splitmix64(right ^ keys[r]) & half_mask);
+                        left = right;
+                        right = next;
+                    }
+                    return (left << half_bits) | right;
+                }
+        };
+    }
+
+    //=====================================================================================================================
+    // Binary dataset
+    //
+    // Format (version 1, host byte order):
+    //      offset 0    header: magic "MGRDDATA", version, byte-order mark, num_features, num_targets, num_samples
+    //      offset 64   num_samples rows of (num_features + num_targets) float32: features, then targets
+    //=====================================================================================================================
+
+    namespace dataset_detail{
+        constexpr char kMagic[8] = {'M', 'G', 'R', 'D', 'D', 'A', 'T', 'A'};
+        constexpr std::uint32_t kVersion = 1;
+        constexpr std::uint32_t kByteOrderMark = 0x01020304;
+
+        struct Header{
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byte_order;
+            std::uint32_t num_features;
+            std::uint32_t num_targets;
+            std::uint64_t num_samples;
+            std::uint8_t reserved[32];
+        };
+        static_assert(sizeof(Header) == 64, "dataset header must be 64 bytes");
+    }
+
+    // Writes n samples, X (n x num_features) and Y (n x num_targets) row-major, as a binary dataset. Throws
+    // std::runtime_error if the shape does not fit the header or the file cannot be written.
+    inline void write_binary_dataset(const std::string& path, const double* X, const double* Y, std::size_t n,
+                                     std::size_t num_features, std::size_t num_targets){
+        using namespace dataset_detail;
+        if(num_features == 0 || num_features > UINT32_MAX || num_targets > UINT32_MAX){
+            throw std::runtime_error("dataset " + path + ": " + std::to_string(num_features) + " features and " +
+                                     std::to_string(num_targets) + " targets do not fit the header");
+        }
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byte_order = kByteOrderMark;
+        header.num_features = static_cast<std::uint32_t>(num_features);
+        header.num_targets = static_cast<std::uint32_t>(num_targets);
+        header.num_samples = n;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::vector<float> row(num_features + num_targets);
+        for(std::size_t i=0; i<n; ++i){
+            std::copy(X + i*num_features, X + (i+1)*num_features, row.begin());
+            std::copy(Y + i*num_targets, Y + (i+1)*num_targets, row.begin() + num_features);
+            out.write(reinterpret_cast<const char*>(row.data()), row.size()*sizeof(float));
+        }
+        if(!out) throw std::runtime_error("dataset " + path + ": write failed");
+    }
+
+    class BinaryDataset : public Source{
+        public:
+            BinaryDataset(const std::string& path, bool shuffle = false, std::uint64_t seed = 0)
+                : shuffle(shuffle), seed(seed){
+                const int fd = ::open(path.c_str(), O_RDONLY);
+                if(fd < 0) throw std::runtime_error("dataset " + path + ": cannot open");
+                struct stat st;
+                if(::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(dataset_detail::Header)){
+                    ::close(fd);
+                    throw std::runtime_error("dataset " + path + ": file too small");
+                }
+                size = static_cast<std::size_t>(st.st_size);
+                void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if(mapped == MAP_FAILED) throw std::runtime_error("dataset " + path + ": mmap failed");
+                base = static_cast<const unsigned char*>(mapped);
+
+                const auto* h = reinterpret_cast<const dataset_detail::Header*>(base);
+                // Row width in size_t: the uint32 sum of a crafted header could wrap to 0. num_samples is bounded
+                // by division before the product is formed, so the size comparison cannot wrap either.
+                const std::size_t row_bytes = (std::size_t(h->num_features) + h->num_targets) * sizeof(float);
+                const std::size_t payload = size - sizeof(dataset_detail::Header);
+                const char* error = nullptr;
+                if(std::memcmp(h->magic, dataset_detail::kMagic, sizeof(h->magic)) != 0) error = "bad magic";
+                else if(h->byte_order != dataset_detail::kByteOrderMark) error = "written on a host with a different byte order";
+                else if(h->version != dataset_detail::kVersion) error = "unsupported version";
+                else if(h->num_features == 0) error = "no features";
+                else if(h->num_samples > payload / row_bytes || h->num_samples*row_bytes != payload) error = "truncated or trailing data";
+                if(error){
+                    ::munmap(const_cast<unsigned char*>(base), size);
+                    throw std::runtime_error("dataset " + path + ": " + error);
+                }
+                features = h->num_features;
+                targets = h->num_targets;
+                samples = h->num_samples;
+                rows = reinterpret_cast<const float*>(base + sizeof(dataset_detail::Header));
+                ::madvise(const_cast<unsigned char*>(base), size, shuffle ? MADV_RANDOM : MADV_SEQUENTIAL);
+                rewind(0);
+            }
+
+            ~BinaryDataset() override{
+                ::munmap(const_cast<unsigned char*>(base), size);
+            }
+
+            BinaryDataset(const BinaryDataset&) = delete;
+            BinaryDataset& operator=(const BinaryDataset&) = delete;
+
+            std::size_t num_features() const override { return features; }
+            std::size_t num_targets() const override { return targets; }
+            std::size_t num_samples() const { return samples; }
+
+            void rewind(std::uint64_t epoch) override{
+                cursor = 0;
+                order = dataset_detail::Permutation(samples, splitmix64(seed) ^ epoch);
+            }
+
+            bool next(float* x, float* y) override{
+                if(cursor == samples) return false;
+                const std::uint64_t i = shuffle ? order(cursor) : cursor;
+                ++cursor;
+                const float* row = rows + i*(features + targets);
+                std::memcpy(x, row, features*sizeof(float));
+                std::memcpy(y, row + features, targets*sizeof(float));
+                return true;
+            }
+
+        private:
+            const unsigned char* base = nullptr;
+            std::size_t size = 0;
+            const float* rows = nullptr;
+            std::size_t features = 0;
+            std::size_t targets = 0;
+            std::uint64_t samples = 0;
+
+            bool shuffle;
+            std::uint64_t seed;
+            dataset_detail::Permutation order;
+            std::uint64_t cursor = 0;
+    };
+
+    //=====================================================================================================================
+    // CSV dataset
+    //
+    // One sample per line, comma-separated numbers; the last num_targets columns are the targets. The file is
+    // read in fixed-size chunks and parsed in place with std::from_chars. With shuffle_buffer > 0, samples go
+    // through a buffer of that many rows and each output is drawn at random from it (the larger the buffer,
+    // the closer to a full shuffle).
+    //=====================================================================================================================
+
+    class CsvDataset : public Source{
+        public:
+            CsvDataset(const std::string& path, std::size_t num_targets, bool has_header = false,
+                       std::size_t shuffle_buffer = 0, std::uint64_t seed = 0)
+                : path(path), targets(num_targets), has_header(has_header), capacity(shuffle_buffer), seed(seed){
+                // The column count comes from the first data line.
+                open();
+                std::vector<float> row;
+                if(!read_row(row)) throw std::runtime_error("dataset " + path + ": no data rows");
+                if(row.size() <= targets) throw std::runtime_error("dataset " + path + ": fewer columns than targets + 1");
+                features = row.size() - targets;
+                rewind(0);
+            }
+
+            ~CsvDataset() override{
+                if(file) std::fclose(file);
+            }
+
+            CsvDataset(const CsvDataset&) = delete;
+            CsvDataset& operator=(const CsvDataset&) = delete;
+
+            std::size_t num_features() const override { return features; }
+            std::size_t num_targets() const override { return targets; }
+
+            void rewind(std::uint64_t epoch) override{
+                open();
+                gen.seed(splitmix64(seed) ^ epoch);
+                pool.clear();
+                pool_rows = 0;
+                exhausted = false;
+            }
+
+            bool next(float* x, float* y) override{
+                const std::size_t width = features + targets;
+                if(capacity == 0){
+                    if(!read_row(scratch)) return false;
+                    emit(scratch.data(), x, y);
+                    return true;
+                }
+                // Keep the pool full while the file lasts, then drain it.
+                while(!exhausted && pool_rows < capacity){
+                    if(!read_row(scratch)){
+                        exhausted = true;
+                        break;
+                    }
+                    pool.insert(pool.end(), scratch.begin(), scratch.end());
+                    ++pool_rows;
+                }
+                if(pool_rows == 0) return false;
+                const std::size_t pick = std::uniform_int_distribution<std::size_t>(0, pool_rows - 1)(gen);
+                emit(pool.data() + pick*width, x, y);
+                // Fill the hole with the last row.
+                std::copy(pool.end() - width, pool.end(), pool.begin() + pick*width);
+                pool.resize(pool.size() - width);
+                --pool_rows;
+                return true;
+            }
+
+        private:
+            static constexpr std::size_t kChunk = 1 << 20;
+
+            std::string path;
+            std::size_t features = 0;
+            std::size_t targets;
+            bool has_header;
+            std::size_t capacity;
+            std::uint64_t seed;
+
+            std::FILE* file = nullptr;
+            std::vector<char> chunk;
+            std::size_t begin = 0, end = 0;     // unparsed bytes of chunk
+            bool eof = false;
+
+            std::mt19937_64 gen;
+            std::vector<float> pool;            // shuffle buffer, pool_rows rows
+            std::size_t pool_rows = 0;
+            bool exhausted = false;
+            std::vector<float> scratch;
+
+            void open(){
+                if(file) std::fclose(file);
+                file = std::fopen(path.c_str(), "rb");
+                if(!file) throw std::runtime_error("dataset " + path + ": cannot open");
+                chunk.resize(kChunk);
+                begin = end = 0;
+                eof = false;
+                if(has_header){
+                    const char* line;
+                    std::size_t len;
+                    next_line(line, len);
+                }
+            }
+
+            // Points line at the next line (without its terminator); false at end of file.
+            bool next_line(const char*& line, std::size_t& len){
+                while(true){
+                    const char* start = chunk.data() + begin;
+                    const char* newline = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+                    if(newline){
+                        line = start;
+                        len = newline - start;
+                        begin += len + 1;
+                        return true;
+                    }
+                    if(eof){
+                        if(begin == end) return false;
+                        line = start;
+                        len = end - begin;
+                        begin = end;
+                        return true;
+                    }
+                    // Move the partial line to the front and read more behind it.
+                    std::memmove(chunk.data(), start, end - begin);
+                    end -= begin;
+                    begin = 0;
+                    if(end == chunk.size()) chunk.resize(chunk.size()*2);    // a line longer than the chunk
+                    const std::size_t got = std::fread(chunk.data() + end, 1, chunk.size() - end, file);
+                    end += got;
+                    if(got == 0) eof = true;
+                }
+            }
+
+            bool read_row(std::vector<float>& row){
+                const char* line;
+                std::size_t len;
+                while(next_line(line, len)){
+                    while(len && (line[len-1] == '\r' || line[len-1] == ' ')) --len;
+                    if(len == 0) continue;
+                    row.clear();
+                    const char* p = line;
+                    const char* stop = line + len;
+                    while(true){
+                        while(p < stop && *p == ' ') ++p;
+                        float v;
+                        auto res = std::from_chars(p, stop, v);
+                        if(res.ec != std::errc()) throw std::runtime_error("dataset " + path + ": cannot parse '" + std::string(line, len) + "'");
+                        row.push_back(v);
+                        p = res.ptr;
+                        while(p < stop && *p == ' ') ++p;
+                        if(p == stop) break;
+                        if(*p != ',') throw std::runtime_error("dataset " + path + ": expected ',' in '" + std::string(line, len) + "'");
+                        ++p;
+                    }
+                    if(features && row.size() != features + targets){
+                        throw std::runtime_error("dataset " + path + ": row with " + std::to_string(row.size()) + " columns, expected " + std::to_string(features + targets));
+                    }
+                    return true;
+                }
+                return false;
+            }
+
+            void emit(const float* row, float* x, float* y) const{
+                std::copy(row, row + features, x);
+                std::copy(row + features, row + features + targets, y);
+            }
+    };
+
+    //=====================================================================================================================
+    // Mini-batches
+    //=====================================================================================================================
+
+    struct Batch{
+        std::size_t size = 0;
+        std::size_t num_features = 0;
+        std::size_t num_targets = 0;
+        std::vector<float> x;       // size x num_features, row-major
+        std::vector<float> y;       // size x num_targets, row-major
+
+        // The inputs as a (size x num_features) leaf tensor, e.g. for mlp(batch.inputs()).
+        std::shared_ptr<Tensor> inputs() const{
+            auto output = std::make_shared<Tensor>(size, num_features);
+            std::copy(x.begin(), x.end(), output->values.begin());
+            return output;
+        }
+    };
+
+    class DataLoader{
+        public:
+            // Every batch holds exactly batch_size samples; a final partial batch is dropped.
+            DataLoader(Source& source, std::size_t batch_size, bool prefetch = true)
+                : source(source), batch_size(batch_size), prefetch(prefetch){
+                init(staged);
+                if(prefetch){
+                    worker = std::thread([this](){ run(); });
+                }
+            }
+
+            ~DataLoader(){
+                if(prefetch){
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                    }
+                    cv.notify_all();
+                    worker.join();
+                }
+            }
+
+            DataLoader(const DataLoader&) = delete;
+            DataLoader& operator=(const DataLoader&) = delete;
+
+            // Rewinds the source and starts producing the first batch of the next epoch.
+            void start_epoch(){
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this](){ return !producing; });
+                source.rewind(epoch++);
+                ready = false;
+                done = false;
+                active = true;
+                lock.unlock();
+                cv.notify_all();
+            }
+
+            // Fills batch with the next mini-batch of the epoch; false once the epoch is done. The buffers of
+            // batch are handed back to the loader for reuse, so steady-state batches allocate nothing.
+            bool next(Batch& batch){
+                init(batch);
+                if(!prefetch){
+                    if(!active || !fill(batch)){
+                        active = false;
+                        return false;
+                    }
+                    return true;
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this](){ return ready || done || !active; });
+                if(!ready){
+                    active = false;
+                    return false;
+                }
+                std::swap(batch.x, staged.x);
+                std::swap(batch.y, staged.y);
+                ready = false;
+                lock.unlock();
+                cv.notify_all();
+                return true;
+            }
+
+        private:
+            Source& source;
+            std::size_t batch_size;
+            bool prefetch;
+            std::uint64_t epoch = 0;
+
+            std::thread worker;
+            std::mutex mutex;
+            std::condition_variable cv;
+            Batch staged;               // filled by the worker
+            bool ready = false;         // staged holds a batch
+            bool done = false;          // the source is exhausted for this epoch
+            bool active = false;        // an epoch is in progress
+            bool producing = false;     // the worker is reading from the source
+            bool stopping = false;
+
+            void init(Batch& batch) const{
+                batch.size = batch_size;
+                batch.num_features = source.num_features();
+                batch.num_targets = source.num_targets();
+                batch.x.resize(batch_size*batch.num_features);
+                batch.y.resize(batch_size*batch.num_targets);
+            }
+
+            bool fill(Batch& batch){
+                for(std::size_t i=0; i<batch_size; ++i){
+                    if(!source.next(batch.x.data() + i*batch.num_features, batch.y.data() + i*batch.num_targets)) return false;
+                }
+                return true;
+            }
+
+            void run(){
+                std::unique_lock<std::mutex> lock(mutex);
+                while(true){
+                    cv.wait(lock, [this](){ return stopping || (active && !ready && !done); });
+                    if(stopping) return;
+                    producing = true;
+                    lock.unlock();
+                    const bool ok = fill(staged);
+                    lock.lock();
+                    producing = false;
+                    if(ok) ready = true;
+                    else done = true;
+                    cv.notify_all();
+                }
+            }
+    };
+}
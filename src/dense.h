@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <cassert>
+
+#include "tensor.h"
+#include "kernels.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Dense layer
+    //
+    // Tensor-level counterpart of Layer: y = tanh(W x + b) with the weights stored as one contiguous
+    // row-major (num_out x num_in) matrix. A forward call adds a single node to the graph no matter how
+    // wide the layer is, and both passes run as matrix kernels (see kernels.h).
+    //
+    // How to use:
+    //      DenseLayer l1(3, 512), l2(512, 1);
+    //      auto y = l2(l1(Tensor::from_data(batch, 3, xs)));   // (batch x 1) tensor
+    //      auto loss = ...y->at(i, 0)...;                      // scalar Value ops from here on
+    //      loss->backward();                                   // fills l1.W->grads, l1.b->grads, ...
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicDenseLayer{
+        public:
+            using Value = BasicValue<T>;
+            using Tensor = BasicTensor<T>;
+
+            int num_in;
+            int num_out;
+            std::string layer_name;
+            std::shared_ptr<Tensor> W;
+            std::shared_ptr<Tensor> b;
+
+            BasicDenseLayer(int num_in, int num_out, std::string layer_name = "dense")
+                : num_in(num_in), num_out(num_out), layer_name(layer_name){
+                std::random_device rd;
+                std::mt19937 gen(rd());
+                std::uniform_real_distribution<> dis(-1.0, 1.0);
+
+                W = std::make_shared<Tensor>(num_out, num_in, Op::None, std::vector<std::shared_ptr<Value>>{}, layer_name+".W");
+                b = std::make_shared<Tensor>(1, num_out, Op::None, std::vector<std::shared_ptr<Value>>{}, layer_name+".b");
+                for(auto& w : W->values) w = dis(gen);
+                for(auto& v : b->values) v = dis(gen);
+            }
+
+            // x is (batch x num_in); the output is (batch x num_out).
+            std::shared_ptr<Tensor> operator()(const std::shared_ptr<Tensor>& x){
+                assert(("input size must match the num_in", x->cols == static_cast<size_t>(num_in)));
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Forward);
+                const size_t n = x->rows;
+                auto output = std::make_shared<Tensor>(n, num_out, Op::Dense, std::vector<std::shared_ptr<Value>>{x, W, b});
+
+                output->forward_prop = [x = x.get(), W = W.get(), b = b.get(), out = output.get()](){
+                    kernels::linear_tanh_forward(x->values.data(), W->values.data(), b->values.data(), out->values.data(),
+                                                 x->rows, x->cols, out->cols);
+                };
+                output->forward_prop();
+
+                output->back_prop = [x = x.get(), W = W.get(), b = b.get(), out = output.get()](){
+                    kernels::linear_tanh_backward(x->values.data(), W->values.data(), out->values.data(), out->grads.data(),
+                                                  x->grads.data(), W->grads.data(), b->grads.data(),
+                                                  x->rows, x->cols, out->cols);
+                };
+                return output;
+            }
+
+            // Scalar convenience path: packs the Values into a (1 x num_in) tensor and unpacks the result.
+            std::vector<std::shared_ptr<Value>> operator()(const std::vector<std::shared_ptr<Value>>& x){
+                return (*this)(Tensor::from_values(x))->to_values();
+            }
+
+            std::vector<std::shared_ptr<Tensor>> parameters(){
+                return {W, b};
+            }
+
+            void zero_grad(){
+                W->zero_grad();
+                b->zero_grad();
+            }
+    };
+
+    using DenseLayer = BasicDenseLayer<double>;
+    using DenseLayerf = BasicDenseLayer<float>;
+}
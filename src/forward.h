@@ -0,0 +1,282 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "nn.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Forward-mode AD
+    //
+    // A Dual carries a value and its tangents, i.e. the derivatives of that value along N input directions, and
+    // propagates both through every op as it is evaluated. There is no graph and no tape: memory is whatever the
+    // Duals themselves take, and a derivative is available as soon as the value is.
+    //
+    // The op set is the one of Value (+ - * /, pow, pow_with_base, exp, tanh), and values are computed with
+    // the same operations as the Value graph (a - b as a + (-1)*b, a / b as a * b^-1), so they match it bit for
+    // bit. Dual (N = 1) gives one directional derivative per pass. DualN<N> gives N at once, e.g. N columns
+    // of a Jacobian.
+    //
+    // How to use:
+    //      Dual x = Dual::variable(0.5, 0), w(2.0);
+    //      Dual y = (x*w + 1.0).tanh();            // y.value, y.tangent[0] = dy/dx
+    //
+    //      auto [y, Jv] = jvp(mlp, x, v);          // MLP outputs and J*v, in one pass
+    //      auto uJ = vjp(mlp, x, u);               // u^T*J, reverse mode over raw buffers
+    //      auto J = jacobian(mlp, x);              // (num_out x num_in), 8 columns per pass
+    //=====================================================================================================================
+
+    template<typename T, std::size_t N>
+    class BasicDual{
+        public:
+            using scalar_type = T;
+            static constexpr std::size_t num_tangents = N;
+
+            T value;
+            std::array<T, N> tangent;
+
+            // A constant: all tangents zero.
+            BasicDual(T value = T(0)) : value(value), tangent{} {}
+
+            BasicDual(T value, const std::array<T, N>& tangent) : value(value), tangent(tangent) {}
+
+            // An input seeded with the unit tangent along direction k.
+            static BasicDual variable(T value, std::size_t k = 0){
+                BasicDual x(value);
+                x.tangent[k] = T(1);
+                return x;
+            }
+
+            //=====================================================================================================================
+            // (+), (-), (*), (/) operations
+            //
+            // With another Dual or a constant on either side, as for Value.
+            //=====================================================================================================================
+
+            friend BasicDual operator+(const BasicDual& a, const BasicDual& b){
+                BasicDual y(a.value + b.value);
+                for(std::size_t k=0; k<N; ++k) y.tangent[k] = a.tangent[k] + b.tangent[k];
+                return y;
+            }
+
+            friend BasicDual operator*(const BasicDual& a, const BasicDual& b){
+                BasicDual y(a.value * b.value);
+                for(std::size_t k=0; k<N; ++k) y.tangent[k] = a.tangent[k] * b.value + a.value * b.tangent[k];
+                return y;
+            }
+
+            friend BasicDual operator-(const BasicDual& a, const BasicDual& b){
+                return a + T(-1) * b;
+            }
+
+            friend BasicDual operator/(const BasicDual& a, const BasicDual& b){
+                return a * b.pow(T(-1));
+            }
+
+            friend BasicDual operator+(const BasicDual& a, T b){
+                BasicDual y(a);
+                y.value = a.value + b;
+                return y;
+            }
+
+            friend BasicDual operator+(T a, const BasicDual& b){
+                return b + a;
+            }
+
+            friend BasicDual operator*(const BasicDual& a, T b){
+                BasicDual y(a.value * b);
+                for(std::size_t k=0; k<N; ++k) y.tangent[k] = b * a.tangent[k];
+                return y;
+            }
+
+            friend BasicDual operator*(T a, const BasicDual& b){
+                return b * a;
+            }
+
+            friend BasicDual operator-(const BasicDual& a, T b){
+                return a + T(-1) * b;
+            }
+
+            friend BasicDual operator-(T a, const BasicDual& b){
+                return a + T(-1) * b;
+            }
+
+            friend BasicDual operator/(const BasicDual& a, T b){
+                return a * std::pow(b, T(-1));
+            }
+
+            friend BasicDual operator/(T a, const BasicDual& b){
+                return a * b.pow(T(-1));
+            }
+
+            //=====================================================================================================================
+            // (pow), (exp), (tanh) operations
+            //=====================================================================================================================
+
+            // y = x^a
+            BasicDual pow(T a) const{
+                BasicDual y(std::pow(value, a));
+                const T dy = a * std::pow(value, a - 1);
+                for(std::size_t k=0; k<N; ++k) y.tangent[k] = dy * tangent[k];
+                return y;
+            }
+
+            // y = a^x
+            BasicDual pow_with_base(T a) const{
+                BasicDual y(std::pow(a, value));
+                const T dy = y.value * std::log(a);
+                for(std::size_t k=0; k<N; ++k) y.tangent[k] = dy * tangent[k];
+                return y;
+            }
+
+            BasicDual exp() const{
+                BasicDual y(std::exp(value));
+                for(std::size_t k=0; k<N; ++k) y.tangent[k] = y.value * tangent[k];
+                return y;
+            }
+
+            BasicDual tanh() const{
+                BasicDual y((std::exp(2*value) - 1) / (std::exp(2*value) + 1));
+                const T dy = 1 - y.value*y.value;
+                for(std::size_t k=0; k<N; ++k) y.tangent[k] = dy * tangent[k];
+                return y;
+            }
+    };
+
+    using Dual = BasicDual<double, 1>;
+    using Dualf = BasicDual<float, 1>;
+    template<std::size_t N> using DualN = BasicDual<double, N>;
+
+    //=====================================================================================================================
+    // MLP in forward mode
+    //
+    // predict_dual() is MLP::predict over Duals: the values are bit-identical to predict(), and the tangents
+    // are J times the input tangents. Activations live in per-thread scratch buffers, so evaluation allocates
+    // nothing after the first call and memory does not grow with depth.
+    //=====================================================================================================================
+
+    // y receives layers.back().num_out Duals.
+    template<typename T, std::size_t N>
+    void predict_dual(const BasicMLP<T>& mlp, const BasicDual<T, N>* x, BasicDual<T, N>* y){
+        static thread_local std::vector<BasicDual<T, N>> a, b;
+        const BasicDual<T, N>* input = x;
+        for(size_t l=0; l<mlp.layers.size(); ++l){
+            const auto& layer = mlp.layers[l];
+            BasicDual<T, N>* output = y;
+            if(l+1 < mlp.layers.size()){
+                auto& buf = (l % 2 == 0) ? a : b;
+                buf.resize(layer.num_out);
+                output = buf.data();
+            }
+            for(size_t j=0; j<layer.neurons.size(); ++j){
+                const auto& neuron = layer.neurons[j];
+                // Same summation order as Neuron::predict for the value.
+                BasicDual<T, N> z(neuron.b->data);
+                for(size_t i=0; i<neuron.ws.size(); ++i){
+                    const T w = neuron.ws[i]->data;
+                    z.value = z.value + w * input[i].value;
+                    for(std::size_t k=0; k<N; ++k) z.tangent[k] += w * input[i].tangent[k];
+                }
+                output[j] = z.tanh();
+            }
+            input = output;
+        }
+    }
+
+    // Outputs of the MLP at x and the Jacobian-vector product J*v.
+    template<typename T>
+    std::pair<std::vector<T>, std::vector<T>> jvp(const BasicMLP<T>& mlp, const std::vector<T>& x, const std::vector<T>& v){
+        assert(("input size must match the num_in of the first layer", x.size() == static_cast<size_t>(mlp.layers[0].num_in)));
+        assert(("tangent size must match the input size", v.size() == x.size()));
+        std::vector<BasicDual<T, 1>> xs(x.size()), ys(mlp.layers.back().num_out);
+        for(size_t i=0; i<x.size(); ++i){
+            xs[i] = BasicDual<T, 1>(x[i], {v[i]});
+        }
+        predict_dual(mlp, xs.data(), ys.data());
+        std::pair<std::vector<T>, std::vector<T>> result;
+        for(const auto& y : ys){
+            result.first.push_back(y.value);
+            result.second.push_back(y.tangent[0]);
+        }
+        return result;
+    }
+
+    // Full (num_out x num_in) Jacobian at x, row-major, N columns per pass.
+    template<std::size_t N = 8, typename T>
+    std::vector<T> jacobian(const BasicMLP<T>& mlp, const std::vector<T>& x){
+        assert(("input size must match the num_in of the first layer", x.size() == static_cast<size_t>(mlp.layers[0].num_in)));
+        const size_t n = x.size(), m = mlp.layers.back().num_out;
+        std::vector<T> J(m*n);
+        std::vector<BasicDual<T, N>> xs(n), ys(m);
+        for(size_t begin=0; begin<n; begin+=N){
+            for(size_t i=0; i<n; ++i){
+                xs[i] = BasicDual<T, N>(x[i]);
+                if(i >= begin && i < begin + N) xs[i].tangent[i - begin] = T(1);
+            }
+            predict_dual(mlp, xs.data(), ys.data());
+            for(size_t r=0; r<m; ++r){
+                for(size_t k=0; k<N && begin + k < n; ++k){
+                    J[r*n + begin + k] = ys[r].tangent[k];
+                }
+            }
+        }
+        return J;
+    }
+
+    // Vector-Jacobian product u^T*J with respect to the inputs. Reverse mode over raw activation buffers: no
+    // graph is built and the parameters' grads are left alone.
+    template<typename T>
+    std::vector<T> vjp(const BasicMLP<T>& mlp, const std::vector<T>& x, const std::vector<T>& u){
+        assert(("input size must match the num_in of the first layer", x.size() == static_cast<size_t>(mlp.layers[0].num_in)));
+        assert(("cotangent size must match the output size", u.size() == static_cast<size_t>(mlp.layers.back().num_out)));
+        const size_t L = mlp.layers.size();
+        std::vector<std::vector<T>> acts(L + 1);
+        acts[0] = x;
+        for(size_t l=0; l<L; ++l){
+            acts[l+1].resize(mlp.layers[l].num_out);
+            mlp.layers[l].predict(acts[l].data(), acts[l+1].data());
+        }
+
+        std::vector<T> delta = u, prev;
+        for(size_t l=L; l-- > 0;){
+            const auto& layer = mlp.layers[l];
+            prev.assign(layer.num_in, T(0));
+            for(size_t j=0; j<layer.neurons.size(); ++j){
+                const T a = acts[l+1][j];
+                const T dz = (1 - a*a) * delta[j];
+                const auto& ws = layer.neurons[j].ws;
+                for(size_t i=0; i<ws.size(); ++i){
+                    prev[i] += ws[i]->data * dz;
+                }
+            }
+            delta.swap(prev);
+        }
+        return delta;
+    }
+
+    // Derivative of any function written against Duals along v: f maps std::vector<BasicDual<T, 1>> to
+    // std::vector<BasicDual<T, 1>>. Returns f(x) and J*v.
+    template<typename T, typename F,
+             typename = std::enable_if_t<std::is_invocable_v<F&, std::vector<BasicDual<T, 1>>&>>>
+    std::pair<std::vector<T>, std::vector<T>> jvp(F&& f, const std::vector<T>& x, const std::vector<T>& v){
+        assert(("tangent size must match the input size", v.size() == x.size()));
+        std::vector<BasicDual<T, 1>> xs(x.size());
+        for(size_t i=0; i<x.size(); ++i){
+            xs[i] = BasicDual<T, 1>(x[i], {v[i]});
+        }
+        const std::vector<BasicDual<T, 1>> ys = f(xs);
+        std::pair<std::vector<T>, std::vector<T>> result;
+        for(const auto& y : ys){
+            result.first.push_back(y.value);
+            result.second.push_back(y.tangent[0]);
+        }
+        return result;
+    }
+}
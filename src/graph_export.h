@@ -0,0 +1,318 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "block.h"
+#include "nn.h"
+#include "tensor.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Graph export
+    //
+    // Streams the graph rooted at a Value to a DOT or JSON file. Nodes are visited in the cached topological
+    // order (built iteratively) and written as they are reached, each followed by the edges from its inputs,
+    // so memory beyond that order is a few bytes per node and graphs of millions of nodes are fine. Nothing is
+    // laid out; render small DOT files with `dot -Tsvg`.
+    //
+    // Detail levels:
+    //  - Values:   every node, as draw_value_graph shows it (op, label, data, grad).
+    //  - Neurons:  every Neuron call collapses into one node with its activation, gradient and the L2 norm of its
+    //              parameters' gradients. The weight and bias leaves disappear.
+    //  - Layers:   every Layer call collapses into one node with the number of neurons, activation mean/min/max,
+    //              the L2 norm of the output gradients and of the layer's parameter gradients.
+    // Summarizing needs the MLP the graph was built with, to recognise its neurons. A node that is not part of a
+    // recognised Neuron or Layer is written as in Values mode, including any parameter it reads directly.
+    //
+    // How to use:
+    //      export_graph_dot(loss, "graph.dot");
+    //
+    //      GraphExportOptions options;
+    //      options.detail = GraphDetail::Layers;
+    //      options.model = &mlp;
+    //      export_graph_json(loss, "graph.json", options);
+    //
+    // JSON layout: {"nodes": [{"id", "kind", ..., "inputs": [id, ...]}, ...]}, with kind "value", "neuron" or
+    // "layer".
+    //=====================================================================================================================
+
+    enum class GraphDetail{
+        Values,
+        Neurons,
+        Layers
+    };
+
+    struct GraphExportOptions{
+        GraphDetail detail = GraphDetail::Values;
+        const MLP* model = nullptr;
+    };
+
+    namespace graph_export{
+
+        enum class Format{ Dot, Json };
+
+        constexpr std::uint32_t kPlain = ~std::uint32_t(0);     // written as a Value node
+        constexpr std::uint32_t kHidden = kPlain - 1;           // parameter absorbed into a summary
+
+        struct NeuronRef{
+            std::uint32_t layer;
+            std::uint32_t index;
+        };
+
+        struct Group{
+            std::uint32_t layer;
+            std::uint32_t first;        // topological index of the first member
+            std::uint32_t neurons = 0;
+            double sum = 0.0, min = 0.0, max = 0.0;
+            double grad_sq = 0.0;
+        };
+
+        // Escapes a string for a double-quoted DOT or JSON string. DOT record labels also reserve {}|<>.
+        inline std::string escape(const std::string& s, Format format){
+            std::string out;
+            out.reserve(s.size());
+            for(char c : s){
+                if(c == '"' || c == '\\') out += '\\';
+                else if(format == Format::Dot && (c == '{' || c == '}' || c == '|' || c == '<' || c == '>')) out += '\\';
+                if(format == Format::Json && static_cast<unsigned char>(c) < 0x20){
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                    out += buf;
+                    continue;
+                }
+                out += c;
+            }
+            return out;
+        }
+
+        inline double param_grad_sq(const Neuron& neuron){
+            double s = neuron.b->grad*neuron.b->grad;
+            for(const auto& w : neuron.ws) s += w->grad*w->grad;
+            return s;
+        }
+
+        class Writer{
+            public:
+                Writer(const std::shared_ptr<Value>& root, std::FILE* out, Format format, const GraphExportOptions& options)
+                    : topo(root->topological_order()), out(out), format(format), options(options){
+                    for(size_t i=0; i<topo.size(); ++i){
+                        topo[i]->pass_index = static_cast<std::uint32_t>(i);
+                    }
+                    role.assign(topo.size(), kPlain);
+                    if(options.detail != GraphDetail::Values && options.model) classify();
+                }
+
+                void write(){
+                    emitted.assign(topo.size(), 0);
+                    group_emitted.assign(groups.size(), 0);
+                    group_mark.assign(groups.size(), kPlain);
+                    if(format == Format::Dot) std::fprintf(out, "digraph g {\n  rankdir=LR;\n  node [shape=record];\n");
+                    else std::fprintf(out, "{\"nodes\": [");
+                    for(size_t i=0; i<topo.size(); ++i){
+                        if(role[i] == kPlain) write_value(i);
+                        else if(role[i] != kHidden && options.detail == GraphDetail::Neurons) write_neuron(i);
+                        else if(role[i] != kHidden && !group_emitted[role[i]]) write_group(role[i]);
+                    }
+                    if(format == Format::Dot) std::fprintf(out, "}\n");
+                    else std::fprintf(out, "\n]}\n");
+                }
+
+            private:
+                const std::vector<Value*>& topo;
+                std::FILE* out;
+                Format format;
+                const GraphExportOptions& options;
+                bool first_record = true;
+
+                // Per node: kPlain, kHidden, or (Neurons) the neuron's index into neuron_of / (Layers) its group.
+                std::vector<std::uint32_t> role;
+                std::vector<NeuronRef> neuron_of;
+                std::vector<Group> groups;
+                std::vector<double> layer_param_norm;
+                std::vector<std::uint8_t> emitted;
+                std::vector<std::uint8_t> group_emitted;
+                std::vector<std::uint32_t> group_mark;      // last node whose inputs listed the group
+
+                // Finds the Neuron calls (fused nodes whose bias is a neuron's b) and, for Layers, groups the calls
+                // of one Layer call together: they share the layer and the input vector.
+                void classify(){
+                    const MLP& mlp = *options.model;
+                    std::unordered_map<const Value*, NeuronRef> by_bias;
+                    for(size_t l=0; l<mlp.layers.size(); ++l){
+                        for(size_t j=0; j<mlp.layers[l].neurons.size(); ++j){
+                            by_bias[mlp.layers[l].neurons[j].b.get()] = {static_cast<std::uint32_t>(l), static_cast<std::uint32_t>(j)};
+                        }
+                    }
+                    layer_param_norm.assign(mlp.layers.size(), 0.0);
+                    for(size_t l=0; l<mlp.layers.size(); ++l){
+                        double s = 0.0;
+                        for(const auto& neuron : mlp.layers[l].neurons) s += param_grad_sq(neuron);
+                        layer_param_norm[l] = std::sqrt(s);
+                    }
+
+                    std::unordered_map<std::uint64_t, std::uint32_t> group_of;
+                    for(size_t i=0; i<topo.size(); ++i){
+                        Value* node = topo[i];
+                        if((node->op != Op::LinearTanh && node->op != Op::Linear) || node->prevs.empty()) continue;
+                        auto it = by_bias.find(node->prevs.back().get());
+                        if(it == by_bias.end()) continue;
+                        const NeuronRef ref = it->second;
+                        const size_t n = node->prevs.size() / 2;
+                        for(size_t k=0; k<n; ++k){
+                            if(node->prevs[k]->prevs.empty()) role[node->prevs[k]->pass_index] = kHidden;
+                        }
+                        role[node->prevs.back()->pass_index] = kHidden;
+
+                        if(options.detail == GraphDetail::Neurons){
+                            role[i] = static_cast<std::uint32_t>(neuron_of.size());
+                            neuron_of.push_back(ref);
+                            continue;
+                        }
+                        const std::uint64_t input = n ? node->prevs[n]->pass_index : i;
+                        const std::uint64_t key = (std::uint64_t(ref.layer) << 32) | input;
+                        auto [g, inserted] = group_of.emplace(key, static_cast<std::uint32_t>(groups.size()));
+                        if(inserted){
+                            Group group;
+                            group.layer = ref.layer;
+                            group.first = static_cast<std::uint32_t>(i);
+                            group.min = group.max = node->data;
+                            groups.push_back(group);
+                        }
+                        Group& group = groups[g->second];
+                        group.neurons += 1;
+                        group.sum += node->data;
+                        group.min = std::min(group.min, node->data);
+                        group.max = std::max(group.max, node->data);
+                        group.grad_sq += node->grad*node->grad;
+                        role[i] = g->second;
+                    }
+                }
+
+                std::string id(size_t i) const{
+                    const std::uint32_t r = role[i];
+                    if(r == kPlain || r == kHidden || options.detail == GraphDetail::Neurons) return "n" + std::to_string(i);
+                    return "g" + std::to_string(r);
+                }
+
+                void begin_record(){
+                    std::fputs(format == Format::Json ? (first_record ? "\n  " : ",\n  ") : "  ", out);
+                    first_record = false;
+                }
+
+                // A parameter absorbed into a summary is still written if some other node reads it directly.
+                void emit_hidden(const std::vector<std::shared_ptr<Value>>& inputs){
+                    for(const auto& p : inputs){
+                        const size_t k = p->pass_index;
+                        if(role[k] == kHidden && !emitted[k]) write_value(k);
+                    }
+                }
+
+                // Writes the edges from node i's inputs, each group once.
+                void write_inputs(size_t i, const std::vector<std::shared_ptr<Value>>& inputs){
+                    const std::string target = id(i);
+                    bool first = true;
+                    if(format == Format::Json) std::fprintf(out, ", \"inputs\": [");
+                    for(const auto& p : inputs){
+                        const size_t k = p->pass_index;
+                        const std::uint32_t r = role[k];
+                        if(r != kPlain && r != kHidden && options.detail == GraphDetail::Layers){
+                            if(group_mark[r] == i) continue;
+                            group_mark[r] = static_cast<std::uint32_t>(i);
+                        }
+                        if(format == Format::Json) std::fprintf(out, "%s\"%s\"", first ? "" : ", ", id(k).c_str());
+                        else std::fprintf(out, "  %s -> %s;\n", id(k).c_str(), target.c_str());
+                        first = false;
+                    }
+                    if(format == Format::Json) std::fprintf(out, "]}");
+                }
+
+                void write_value(size_t i){
+                    Value* node = topo[i];
+                    emitted[i] = 1;
+                    std::string shape;
+                    if(node->op == Op::Stack || node->op == Op::Layer || node->op == Op::Dense || node->op == Op::Checkpoint){
+                        if(auto* t = dynamic_cast<const Tensor*>(node)) shape = std::to_string(t->rows) + "x" + std::to_string(t->cols);
+                    }
+                    const std::string op = node->op_label();
+                    if(role[i] != kHidden) emit_hidden(node->prevs);
+                    begin_record();
+                    if(format == Format::Dot){
+                        std::fprintf(out, "n%zu [label=\"{%s%s%s", i, escape(node->label(), format).c_str(),
+                                     op.empty() ? "" : " | ", escape(op, format).c_str());
+                        if(shape.empty()) std::fprintf(out, " | data %.4g | grad %.4g}\"];\n", node->data, node->grad);
+                        else std::fprintf(out, " | tensor %s}\"];\n", shape.c_str());
+                    } else{
+                        std::fprintf(out, "{\"id\": \"n%zu\", \"kind\": \"value\", \"op\": \"%s\", \"label\": \"%s\"", i,
+                                     escape(op, format).c_str(), escape(node->label(), format).c_str());
+                        if(shape.empty()) std::fprintf(out, ", \"data\": %.17g, \"grad\": %.17g", node->data, node->grad);
+                        else std::fprintf(out, ", \"shape\": \"%s\"", shape.c_str());
+                    }
+                    if(role[i] == kHidden) write_inputs(i, {});
+                    else write_inputs(i, node->prevs);
+                }
+
+                void write_neuron(size_t i){
+                    Value* node = topo[i];
+                    const NeuronRef ref = neuron_of[role[i]];
+                    const Layer& layer = options.model->layers[ref.layer];
+                    const double norm = std::sqrt(param_grad_sq(layer.neurons[ref.index]));
+                    const size_t n = node->prevs.size() / 2;
+                    const std::vector<std::shared_ptr<Value>> inputs(node->prevs.begin() + n, node->prevs.begin() + 2*n);
+                    emit_hidden(inputs);
+                    begin_record();
+                    if(format == Format::Dot){
+                        std::fprintf(out, "n%zu [label=\"{%s[%u] | data %.4g | grad %.4g | param grad norm %.4g}\"];\n", i,
+                                     escape(layer.layer_name, format).c_str(), ref.index, node->data, node->grad, norm);
+                    } else{
+                        std::fprintf(out, "{\"id\": \"n%zu\", \"kind\": \"neuron\", \"layer\": \"%s\", \"index\": %u, \"data\": %.17g, \"grad\": %.17g, \"param_grad_norm\": %.17g",
+                                     i, escape(layer.layer_name, format).c_str(), ref.index, node->data, node->grad, norm);
+                    }
+                    write_inputs(i, inputs);
+                }
+
+                void write_group(std::uint32_t g){
+                    group_emitted[g] = 1;
+                    const Group& group = groups[g];
+                    const Layer& layer = options.model->layers[group.layer];
+                    Value* first = topo[group.first];
+                    const size_t n = first->prevs.size() / 2;
+                    const std::vector<std::shared_ptr<Value>> inputs(first->prevs.begin() + n, first->prevs.begin() + 2*n);
+                    const double mean = group.sum / group.neurons;
+                    const double grad_norm = std::sqrt(group.grad_sq);
+                    emit_hidden(inputs);
+                    begin_record();
+                    if(format == Format::Dot){
+                        std::fprintf(out, "g%u [label=\"{%s | %u neurons | mean %.4g min %.4g max %.4g | grad norm %.4g | param grad norm %.4g}\"];\n",
+                                     g, escape(layer.layer_name, format).c_str(), group.neurons, mean, group.min, group.max, grad_norm, layer_param_norm[group.layer]);
+                    } else{
+                        std::fprintf(out, "{\"id\": \"g%u\", \"kind\": \"layer\", \"layer\": \"%s\", \"neurons\": %u, \"mean\": %.17g, \"min\": %.17g, \"max\": %.17g, \"grad_norm\": %.17g, \"param_grad_norm\": %.17g",
+                                     g, escape(layer.layer_name, format).c_str(), group.neurons, mean, group.min, group.max, grad_norm, layer_param_norm[group.layer]);
+                    }
+                    write_inputs(group.first, inputs);
+                }
+        };
+
+        inline bool export_graph(const std::shared_ptr<Value>& root, const std::string& path, Format format, const GraphExportOptions& options){
+            std::FILE* out = std::fopen(path.c_str(), "w");
+            if(!out) return false;
+            Writer(root, out, format, options).write();
+            const bool ok = !std::ferror(out);
+            return std::fclose(out) == 0 && ok;
+        }
+    }
+
+    // Returns false if the file cannot be written.
+    inline bool export_graph_dot(const std::shared_ptr<Value>& root, const std::string& path, const GraphExportOptions& options = {}){
+        return graph_export::export_graph(root, path, graph_export::Format::Dot, options);
+    }
+
+    inline bool export_graph_json(const std::shared_ptr<Value>& root, const std::string& path, const GraphExportOptions& options = {}){
+        return graph_export::export_graph(root, path, graph_export::Format::Json, options);
+    }
+}
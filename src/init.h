@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+#include "random.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Parameter initialization
+    //
+    // Parameters are drawn from a counter-based generator. Draw number `counter` of stream `stream` is a hash
+    // of (seed, stream, counter), with no state carried from one draw to the next. Every weight is therefore a
+    // function of the seed, its layer (the stream) and its position in that layer (the counter). Layers and
+    // neurons can be initialized in any order, on any number of threads, and still come out identical bit for
+    // bit.
+    //
+    // Within layer l, neuron j takes counters j*(num_in+1) .. j*(num_in+1)+num_in-1 for its weights and
+    // j*(num_in+1)+num_in for its bias.
+    //
+    // Schemes (fan_in = num_in, fan_out = num_out of the layer):
+    //  - Uniform:       weights and biases from U(-1, 1), the original initialization.
+    //  - XavierUniform: weights from U(-a, a) with a = sqrt(6 / (fan_in + fan_out)), biases 0.
+    //  - XavierNormal:  weights from N(0, 2 / (fan_in + fan_out)), biases 0.
+    //  - HeUniform:     weights from U(-a, a) with a = sqrt(6 / fan_in), biases 0.
+    //  - HeNormal:      weights from N(0, 2 / fan_in), biases 0.
+    //
+    // How to use:
+    //      InitOptions init;
+    //      init.scheme = Init::XavierUniform;
+    //      init.seed = 42;
+    //      MLP mlp({784, 256, 10}, init);                  // reproducible
+    //
+    //      ThreadPool pool(8);
+    //      MLP same = build_mlp({784, 256, 10}, init, pool);   // same weights, built on 8 threads
+    //=====================================================================================================================
+
+    enum class Init{
+        Uniform,
+        XavierUniform,
+        XavierNormal,
+        HeUniform,
+        HeNormal
+    };
+
+    struct InitOptions{
+        Init scheme = Init::Uniform;
+        std::uint64_t seed = 0;
+    };
+
+    namespace init{
+
+        inline std::uint64_t random_bits(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter){
+            return splitmix64(splitmix64(splitmix64(seed) ^ stream) ^ counter);
+        }
+
+        // U[0, 1) with 53 random bits.
+        inline double uniform(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter){
+            return static_cast<double>(random_bits(seed, stream, counter) >> 11) * 0x1.0p-53;
+        }
+
+        // N(0, 1) by Box-Muller over draws 2*counter and 2*counter+1.
+        inline double normal(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter){
+            const double u1 = 1.0 - uniform(seed, stream, 2*counter);
+            const double u2 = uniform(seed, stream, 2*counter + 1);
+            constexpr double two_pi = 6.283185307179586476925;
+            return std::sqrt(-2.0 * std::log(u1)) * std::cos(two_pi * u2);
+        }
+
+        // Seed for constructors that are not given one.
+        inline std::uint64_t random_seed(){
+            std::random_device rd;
+            return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+        }
+
+        // The draws of one layer.
+        class LayerInit{
+            public:
+                LayerInit(const InitOptions& options, std::size_t layer, int fan_in, int fan_out)
+                    : scheme(options.scheme), seed(options.seed), stream(layer), stride(static_cast<std::uint64_t>(fan_in) + 1){
+                    switch(scheme){
+                        case Init::Uniform:       scale = 1.0; break;
+                        case Init::XavierUniform: scale = std::sqrt(6.0 / (fan_in + fan_out)); break;
+                        case Init::XavierNormal:  scale = std::sqrt(2.0 / (fan_in + fan_out)); break;
+                        case Init::HeUniform:     scale = std::sqrt(6.0 / fan_in); break;
+                        case Init::HeNormal:      scale = std::sqrt(2.0 / fan_in); break;
+                    }
+                }
+
+                double weight(std::size_t neuron, std::size_t i) const{
+                    return draw(neuron*stride + i);
+                }
+
+                double bias(std::size_t neuron) const{
+                    return scheme == Init::Uniform ? draw(neuron*stride + stride - 1) : 0.0;
+                }
+
+            private:
+                Init scheme;
+                std::uint64_t seed;
+                std::uint64_t stream;
+                std::uint64_t stride;
+                double scale = 1.0;
+
+                double draw(std::uint64_t counter) const{
+                    if(scheme == Init::XavierNormal || scheme == Init::HeNormal){
+                        return scale * normal(seed, stream, counter);
+                    }
+                    return scale * (2.0 * uniform(seed, stream, counter) - 1.0);
+                }
+        };
+    }
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define MICROGRAD_AVX2 1
+#else
+#define MICROGRAD_AVX2 0
+#endif
+
+namespace micrograd{
+namespace kernels{
+
+    //=====================================================================================================================
+    // Dense linear algebra kernels
+    //
+    // AVX2/FMA paths are selected at compile time (build with -mavx2 -mfma or -march=native);
+    // otherwise the scalar loops below are used. All matrices are row-major. dot, axpy and the optimizer
+    // steps are overloaded for float (8 lanes per AVX2 register) and double (4 lanes), and dot also for int8
+    // (32 lanes); the matrix kernels are templates over the element type and pick them up by overload
+    // resolution.
+    //=====================================================================================================================
+
+    // sum_i a[i]*b[i]
+    inline double dot(const double* a, const double* b, std::size_t n){
+        std::size_t i = 0;
+        double sum = 0.0;
+#if MICROGRAD_AVX2
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        for(; i+8<=n; i+=8){
+            acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i), acc0);
+            acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+4), _mm256_loadu_pd(b+i+4), acc1);
+        }
+        for(; i+4<=n; i+=4){
+            acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i), acc0);
+        }
+        acc0 = _mm256_add_pd(acc0, acc1);
+        __m128d lo = _mm256_castpd256_pd128(acc0);
+        __m128d hi = _mm256_extractf128_pd(acc0, 1);
+        lo = _mm_add_pd(lo, hi);
+        sum = _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+#endif
+        for(; i<n; ++i){
+            sum += a[i]*b[i];
+        }
+        return sum;
+    }
+
+    inline float dot(const float* a, const float* b, std::size_t n){
+        std::size_t i = 0;
+        float sum = 0.0f;
+#if MICROGRAD_AVX2
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for(; i+16<=n; i+=16){
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8), _mm256_loadu_ps(b+i+8), acc1);
+        }
+        for(; i+8<=n; i+=8){
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), acc0);
+        }
+        acc0 = _mm256_add_ps(acc0, acc1);
+        __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+        lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+        sum = _mm_cvtss_f32(_mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1)));
+#endif
+        for(; i<n; ++i){
+            sum += a[i]*b[i];
+        }
+        return sum;
+    }
+
+    // sum_i a[i]*b[i] over int8, accumulated in int32. Entries must lie in [-127, 127], as quantize.h produces:
+    // the AVX2 path multiplies |a| by b*sign(a) with maddubs, and pairs of such products fit int16.
+    inline std::int32_t dot(const std::int8_t* a, const std::int8_t* b, std::size_t n){
+        std::size_t i = 0;
+        std::int32_t sum = 0;
+#if MICROGRAD_AVX2
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        for(; i+64<=n; i+=64){
+            const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a+i));
+            const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b+i));
+            const __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a+i+32));
+            const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b+i+32));
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_sign_epi8(a0, a0), _mm256_sign_epi8(b0, a0)), ones));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_sign_epi8(a1, a1), _mm256_sign_epi8(b1, a1)), ones));
+        }
+        for(; i+32<=n; i+=32){
+            const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a+i));
+            const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b+i));
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_sign_epi8(a0, a0), _mm256_sign_epi8(b0, a0)), ones));
+        }
+        acc0 = _mm256_add_epi32(acc0, acc1);
+        __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+        lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, 0x4E));
+        lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, 0xB1));
+        sum = _mm_cvtsi128_si32(lo);
+#endif
+        for(; i<n; ++i){
+            sum += static_cast<std::int32_t>(a[i]) * b[i];
+        }
+        return sum;
+    }
+
+    // y[i] += alpha*x[i]
+    inline void axpy(double alpha, const double* x, double* y, std::size_t n){
+        std::size_t i = 0;
+#if MICROGRAD_AVX2
+        const __m256d a = _mm256_set1_pd(alpha);
+        for(; i+4<=n; i+=4){
+            _mm256_storeu_pd(y+i, _mm256_fmadd_pd(a, _mm256_loadu_pd(x+i), _mm256_loadu_pd(y+i)));
+        }
+#endif
+        for(; i<n; ++i){
+            y[i] += alpha*x[i];
+        }
+    }
+
+    inline void axpy(float alpha, const float* x, float* y, std::size_t n){
+        std::size_t i = 0;
+#if MICROGRAD_AVX2
+        const __m256 a = _mm256_set1_ps(alpha);
+        for(; i+8<=n; i+=8){
+            _mm256_storeu_ps(y+i, _mm256_fmadd_ps(a, _mm256_loadu_ps(x+i), _mm256_loadu_ps(y+i)));
+        }
+#endif
+        for(; i<n; ++i){
+            y[i] += alpha*x[i];
+        }
+    }
+
+    // Momentum step over n parameters: v = mu*v + g; w -= lr*v
+    inline void momentum_step(double lr, double mu, const double* g, double* v, double* w, std::size_t n){
+        std::size_t i = 0;
+#if MICROGRAD_AVX2
+        const __m256d vmu = _mm256_set1_pd(mu);
+        const __m256d vlr = _mm256_set1_pd(-lr);
+        for(; i+4<=n; i+=4){
+            const __m256d vi = _mm256_fmadd_pd(vmu, _mm256_loadu_pd(v+i), _mm256_loadu_pd(g+i));
+            _mm256_storeu_pd(v+i, vi);
+            _mm256_storeu_pd(w+i, _mm256_fmadd_pd(vlr, vi, _mm256_loadu_pd(w+i)));
+        }
+#endif
+        for(; i<n; ++i){
+            v[i] = mu*v[i] + g[i];
+            w[i] += -lr*v[i];
+        }
+    }
+
+    inline void momentum_step(float lr, float mu, const float* g, float* v, float* w, std::size_t n){
+        std::size_t i = 0;
+#if MICROGRAD_AVX2
+        const __m256 vmu = _mm256_set1_ps(mu);
+        const __m256 vlr = _mm256_set1_ps(-lr);
+        for(; i+8<=n; i+=8){
+            const __m256 vi = _mm256_fmadd_ps(vmu, _mm256_loadu_ps(v+i), _mm256_loadu_ps(g+i));
+            _mm256_storeu_ps(v+i, vi);
+            _mm256_storeu_ps(w+i, _mm256_fmadd_ps(vlr, vi, _mm256_loadu_ps(w+i)));
+        }
+#endif
+        for(; i<n; ++i){
+            v[i] = mu*v[i] + g[i];
+            w[i] += -lr*v[i];
+        }
+    }
+
+    // Adam step over n parameters, bias correction folded into step_size:
+    // m = b1*m + (1-b1)*g; v = b2*v + (1-b2)*g^2; w -= step_size * m / (sqrt(v) + eps)
+    inline void adam_step(double step_size, double beta1, double beta2, double eps,
+                          const double* g, double* m, double* v, double* w, std::size_t n){
+        std::size_t i = 0;
+#if MICROGRAD_AVX2
+        const __m256d b1 = _mm256_set1_pd(beta1), nb1 = _mm256_set1_pd(1 - beta1);
+        const __m256d b2 = _mm256_set1_pd(beta2), nb2 = _mm256_set1_pd(1 - beta2);
+        const __m256d vstep = _mm256_set1_pd(-step_size), veps = _mm256_set1_pd(eps);
+        for(; i+4<=n; i+=4){
+            const __m256d gi = _mm256_loadu_pd(g+i);
+            const __m256d mi = _mm256_fmadd_pd(b1, _mm256_loadu_pd(m+i), _mm256_mul_pd(nb1, gi));
+            const __m256d vi = _mm256_fmadd_pd(b2, _mm256_loadu_pd(v+i), _mm256_mul_pd(nb2, _mm256_mul_pd(gi, gi)));
+            _mm256_storeu_pd(m+i, mi);
+            _mm256_storeu_pd(v+i, vi);
+            const __m256d denom = _mm256_add_pd(_mm256_sqrt_pd(vi), veps);
+            _mm256_storeu_pd(w+i, _mm256_fmadd_pd(vstep, _mm256_div_pd(mi, denom), _mm256_loadu_pd(w+i)));
+        }
+#endif
+        for(; i<n; ++i){
+            m[i] = beta1*m[i] + (1 - beta1)*g[i];
+            v[i] = beta2*v[i] + (1 - beta2)*g[i]*g[i];
+            w[i] += -step_size * m[i] / (std::sqrt(v[i]) + eps);
+        }
+    }
+
+    inline void adam_step(float step_size, float beta1, float beta2, float eps,
+                          const float* g, float* m, float* v, float* w, std::size_t n){
+        std::size_t i = 0;
+#if MICROGRAD_AVX2
+        const __m256 b1 = _mm256_set1_ps(beta1), nb1 = _mm256_set1_ps(1 - beta1);
+        const __m256 b2 = _mm256_set1_ps(beta2), nb2 = _mm256_set1_ps(1 - beta2);
+        const __m256 vstep = _mm256_set1_ps(-step_size), veps = _mm256_set1_ps(eps);
+        for(; i+8<=n; i+=8){
+            const __m256 gi = _mm256_loadu_ps(g+i);
+            const __m256 mi = _mm256_fmadd_ps(b1, _mm256_loadu_ps(m+i), _mm256_mul_ps(nb1, gi));
+            const __m256 vi = _mm256_fmadd_ps(b2, _mm256_loadu_ps(v+i), _mm256_mul_ps(nb2, _mm256_mul_ps(gi, gi)));
+            _mm256_storeu_ps(m+i, mi);
+            _mm256_storeu_ps(v+i, vi);
+            const __m256 denom = _mm256_add_ps(_mm256_sqrt_ps(vi), veps);
+            _mm256_storeu_ps(w+i, _mm256_fmadd_ps(vstep, _mm256_div_ps(mi, denom), _mm256_loadu_ps(w+i)));
+        }
+#endif
+        for(; i<n; ++i){
+            m[i] = beta1*m[i] + (1 - beta1)*g[i];
+            v[i] = beta2*v[i] + (1 - beta2)*g[i]*g[i];
+            w[i] += -step_size * m[i] / (std::sqrt(v[i]) + eps);
+        }
+    }
+
+    // Y (n x m) = X (n x k) * W^T + b, where W is (m x k) and b has m entries.
+    // Each weight row is reused across the whole batch while it is hot in cache.
+    template<typename T>
+    void linear_forward(const T* X, const T* W, const T* b, T* Y,
+                        std::size_t n, std::size_t k, std::size_t m){
+        for(std::size_t j=0; j<m; ++j){
+            const T* w = W + j*k;
+            for(std::size_t r=0; r<n; ++r){
+                Y[r*m + j] = b[j] + dot(w, X + r*k, k);
+            }
+        }
+    }
+
+    // Given dY (n x m) of Y = X * W^T + b, accumulates dX (n x k), dW (m x k) and db (m).
+    // Any of dX, dW, db may be null when that gradient is not needed.
+    template<typename T>
+    void linear_backward(const T* X, const T* W, const T* dY,
+                         T* dX, T* dW, T* db,
+                         std::size_t n, std::size_t k, std::size_t m){
+        for(std::size_t j=0; j<m; ++j){
+            const T* w = W + j*k;
+            for(std::size_t r=0; r<n; ++r){
+                const T g = dY[r*m + j];
+                if(g == T(0)) continue;
+                if(dW) axpy(g, X + r*k, dW + j*k, k);
+                if(dX) axpy(g, w, dX + r*k, k);
+                if(db) db[j] += g;
+            }
+        }
+    }
+
+    // Y = tanh(X * W^T + b), the forward pass of a dense tanh layer.
+    template<typename T>
+    void linear_tanh_forward(const T* X, const T* W, const T* b, T* Y,
+                             std::size_t n, std::size_t k, std::size_t m){
+        linear_forward(X, W, b, Y, n, k, m);
+        for(std::size_t i=0; i<n*m; ++i){
+            Y[i] = std::tanh(Y[i]);
+        }
+    }
+
+    // Backward of linear_tanh_forward given its output Y and dY. The pre-activation gradient lives in a
+    // per-thread scratch buffer, so steady-state calls do not allocate.
+    template<typename T>
+    void linear_tanh_backward(const T* X, const T* W, const T* Y, const T* dY,
+                              T* dX, T* dW, T* db,
+                              std::size_t n, std::size_t k, std::size_t m){
+        static thread_local std::vector<T> dz;
+        dz.resize(n*m);
+        for(std::size_t i=0; i<n*m; ++i){
+            dz[i] = (1 - Y[i]*Y[i]) * dY[i];
+        }
+        linear_backward(X, W, dz.data(), dX, dW, db, n, k, m);
+    }
+}
+}
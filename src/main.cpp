@@ -2,68 +2,83 @@
 
 #include "block.h"
 #include "nn.h"
+#include "plan.h"
+#include "optim.h"
 #include "visualizer.h"
 
 using namespace micrograd;
 
 int main() {
-    std::set<std::shared_ptr<Value>> init = {};
     std::vector<std::shared_ptr<Value>> input1 =
-        {std::make_shared<Value>(2.0, init, "", "x1_0"),
-         std::make_shared<Value>(-3.0, init, "", "x1_1"),
-         std::make_shared<Value>(-1.0, init, "", "x1_2")};
+        {std::make_shared<Value>(2.0, "x1_0"),
+         std::make_shared<Value>(-3.0, "x1_1"),
+         std::make_shared<Value>(-1.0, "x1_2")};
 
     std::vector<std::shared_ptr<Value>> input2 =
-        {std::make_shared<Value>(3.0, init, "", "x2_0"),
-         std::make_shared<Value>(-1.0, init, "", "x2_1"),
-         std::make_shared<Value>(0.5, init, "", "x2_2")};
+        {std::make_shared<Value>(3.0, "x2_0"),
+         std::make_shared<Value>(-1.0, "x2_1"),
+         std::make_shared<Value>(0.5, "x2_2")};
 
     std::vector<std::shared_ptr<Value>> input3 =
-        {std::make_shared<Value>(0.5, init, "", "x3_0"),
-         std::make_shared<Value>(1.0, init, "", "x3_1"),
-         std::make_shared<Value>(1.0, init, "", "x3_2")};
+        {std::make_shared<Value>(0.5, "x3_0"),
+         std::make_shared<Value>(1.0, "x3_1"),
+         std::make_shared<Value>(1.0, "x3_2")};
 
     std::vector<std::shared_ptr<Value>> input4 =
-        {std::make_shared<Value>(1.0, init, "", "x4_0"),
-         std::make_shared<Value>(1.0, init, "", "x4_1"),
-         std::make_shared<Value>(-1.0, init, "", "x4_2")};
+        {std::make_shared<Value>(1.0, "x4_0"),
+         std::make_shared<Value>(1.0, "x4_1"),
+         std::make_shared<Value>(-1.0, "x4_2")};
 
     std::vector<std::shared_ptr<Value>> y_gt =
-        {std::make_shared<Value>(1.0, init, "", "y_gt0"),
-         std::make_shared<Value>(-1.0, init, "", "y_gt1"),
-         std::make_shared<Value>(-1.0, init, "", "y_gt2"),
-         std::make_shared<Value>(1.0, init, "", "y_gt3")};
+        {std::make_shared<Value>(1.0, "y_gt0"),
+         std::make_shared<Value>(-1.0, "y_gt1"),
+         std::make_shared<Value>(-1.0, "y_gt2"),
+         std::make_shared<Value>(1.0, "y_gt3")};
 
     std::vector<std::vector<std::shared_ptr<Value>>> inputs = {input1, input2, input3, input4};
+
+    // The four samples as one (4 x 3) batch, so each step runs every layer once over all of them.
+    std::vector<double> batch;
+    for(const auto& input : inputs){
+        for(const auto& x : input){
+            batch.push_back(x->data);
+        }
+    }
+    auto X = Tensor::from_data(inputs.size(), 3, batch.data(), "X");
+
     MLP mlp({3, 4, 1});
-    auto params = mlp.parameters();
+    ParameterStore store;
+    store.add(mlp.parameters());
+    SGD optimizer(store, 0.1);
     int itr = 1;
     double threshold = 1e-4;
-    while(true){
-        auto loss = std::make_shared<Value>(0.0, init, "", "");
+
+    // The graph is identical every iteration, so it is captured once and replayed.
+    auto plan = Plan::capture([&](){
+        // single output regression, sum of squared errors
+        auto y_pred = mlp(X);
+        std::vector<std::shared_ptr<Value>> errors;
         for(int i=0; i<4; ++i){
-            // single output regression
-            auto y_pred = mlp(inputs[i])[0];
-            auto diff = (*y_pred) - (*y_gt[i]);
-            diff = (*diff) * (*diff);
-            loss = (*loss) + (*diff);
+            auto diff = (*y_pred->at(i, 0)) - (*y_gt[i]);
+            errors.push_back((*diff) * (*diff));
         }
+        return sum(errors);
+    });
+    auto loss = plan.output();
+
+    while(true){
+        plan.forward();
         std::cout<<"[Iteration "<<itr<<"]: Loss = "<<loss->data<<std::endl;
 
         if(loss->data < threshold){
-            loss->label = "loss";
+            loss->set_label("loss");
             micrograd::draw_value_graph(loss);
             break;
         }
         
-        for(int i=0; i<params.size(); ++i){
-            params[i]->grad = 0.0;
-        }
-        loss->backward();
-        
-        for(int i=0; i<params.size(); ++i){
-            params[i]->data += -0.1*params[i]->grad;
-        }
+        plan.backward();
+        optimizer.step();
+        profile::step(Value::nVals);
 
         itr += 1;
     }
@@ -77,5 +92,11 @@ int main() {
     
     micrograd::draw_nn_graph(mlp);
 
+    // Only with -DMICROGRAD_PROFILE=ON.
+    if(profile::enabled){
+        profile::write_json("profile.json");
+        profile::write_chrome_trace("profile_trace.json");
+    }
+
     return 0;
 }
@@ -1,40 +1,68 @@
 #pragma once
 
 #include "block.h"
+#include "tensor.h"
+#include "kernels.h"
+#include "init.h"
+#include "params.h"
 #include <vector>
+#include <algorithm>
 #include <random>
+#include <cmath>
 #include <cassert>
 
 namespace micrograd{
 
-    class Neuron{
+    //=====================================================================================================================
+    // Neuron, Layer and MLP are templated on the scalar type T of their Values; Neuron/Layer/MLP (double) and
+    // Neuronf/Layerf/MLPf (float) are the instantiations in use.
+    //
+    // Parameters come from the counter-based initializer in init.h. Constructors that take no InitOptions
+    // draw U(-1, 1) under a random seed, and those that take one are reproducible. Layers and neurons are
+    // built in place, and parameter Values are created without labels. A layer's parameters share one
+    // ParameterBlock (params.h), in the order of the init counters: neuron j's weights, then its bias.
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicNeuron{
         public:
+            using Value = BasicValue<T>;
+            using ParameterBlock = BasicParameterBlock<T>;
+
             std::vector<std::shared_ptr<Value>> ws;
             std::shared_ptr<Value> b;
             std::vector<std::shared_ptr<Value>> params;
 
-            Neuron(int num_in){
-                std::random_device rd;
-                std::mt19937 gen(rd());
-                std::uniform_real_distribution<> dis(-1.0, 1.0);
-                std::set<std::shared_ptr<Value>> init = {};
+            BasicNeuron(int num_in)
+                : BasicNeuron(num_in, init::LayerInit(InitOptions{Init::Uniform, init::random_seed()}, 0, num_in, 1), 0) {}
+
+            // Neuron `index` of the layer whose draws init describes, in a block of its own.
+            BasicNeuron(int num_in, const init::LayerInit& init, size_t index)
+                : BasicNeuron(num_in, init, index, ParameterBlock(static_cast<size_t>(num_in) + 1), 0) {}
 
-                for(size_t i=0; i<num_in; ++i){
-                    auto val = std::make_shared<Value>(dis(gen), init, "", "w"+std::to_string(i));
-                    ws.push_back(val);
+            // Same, with its num_in + 1 parameters in the slots of block starting at first_slot.
+            BasicNeuron(int num_in, const init::LayerInit& init, size_t index, const ParameterBlock& block, size_t first_slot){
+                ws.reserve(num_in);
+                for(size_t i=0; i<static_cast<size_t>(num_in); ++i){
+                    ws.push_back(block.make(first_slot + i, static_cast<T>(init.weight(index, i))));
                 }
-                b = std::make_shared<Value>(dis(gen), init, "", "b0");
+                b = block.make(first_slot + num_in, static_cast<T>(init.bias(index)));
             }
 
             std::shared_ptr<Value> operator()(const std::vector<std::shared_ptr<Value>> &x){
                 assert(("input size must match the number of neurons", ws.size() == x.size()));
-                auto output = b;
-                for(size_t i=0; i<ws.size(); ++i){
-                    auto mult = (*ws[i]) * (*x[i]);
-                    output = (*output) + (*mult);
-                }   
+                // One fused node for tanh(b + w0*x0 + w1*x1 + ...).
+                return linear(ws, x, b, Activation::Tanh);
+            }
 
-                return output->tanh();
+            // No-grad evaluation on raw scalars. Same operations in the same order as operator(), so the result
+            // is bit-identical to the graph path.
+            T predict(const T* x) const{
+                T output = b->data;
+                for(size_t i=0; i<ws.size(); ++i){
+                    output = output + ws[i]->data * x[i];
+                }
+                return (std::exp(2*output) - 1) / (std::exp(2*output) + 1);
             }
 
             std::vector<std::shared_ptr<Value>> parameters() {
@@ -44,32 +72,208 @@ namespace micrograd{
             }
     };
 
-    class Layer{
+    //=====================================================================================================================
+    // Gradient sinks
+    //
+    // The batched backward step of a Layer normally adds its weight and bias gradients to the parameters'
+    // grads. While a GradientSink is installed on a thread, steps run on that thread add them to the sink's
+    // array instead, at the parameters' positions in model.parameters(). Several threads can then backpropagate
+    // graphs built on the same model at once, each into an array of its own (see DataParallelTrainer). Only
+    // batched Layer nodes honor a sink: scalar graphs hold the parameters as operands and write their grads.
+    //
+    // How to use:
+    //      std::vector<double> grads(num_params, 0.0);
+    //      GradientSink sink(mlp, grads.data());
+    //      {
+    //          GradientSink::Scope scope(sink);
+    //          loss->backward();                               // mlp's parameter grads go to grads
+    //      }
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicGradientSink{
+        public:
+            using Value = BasicValue<T>;
+
+            // grads has one entry per parameter of model, in model.parameters() order.
+            template<typename Model>
+            BasicGradientSink(const Model& model, T* grads) : grads(grads){
+                std::size_t offset = 0;
+                for(const auto& layer : model.layers){
+                    if(layer.neurons.empty()) continue;
+                    const auto& first = layer.neurons[0];
+                    layers.push_back({first.ws.empty() ? first.b.get() : first.ws[0].get(), offset});
+                    offset += layer.neurons.size() * (first.ws.size() + 1);
+                }
+            }
+
+            // The gradients of the layer whose first parameter (neuron 0's first weight, or its bias) is
+            // first_param, or null if the layer is not part of the model.
+            T* find(const Value* first_param) const{
+                for(const auto& layer : layers){
+                    if(layer.first == first_param) return grads + layer.offset;
+                }
+                return nullptr;
+            }
+
+            // The sink installed on the calling thread, or null.
+            static const BasicGradientSink* current(){
+                return installed();
+            }
+
+            // Installs a sink on the calling thread for its lifetime.
+            class Scope{
+                public:
+                    explicit Scope(const BasicGradientSink& sink) : previous(installed()){
+                        installed() = &sink;
+                    }
+                    ~Scope(){
+                        installed() = previous;
+                    }
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+
+                private:
+                    const BasicGradientSink* previous;
+            };
+
+        private:
+            struct LayerGrads{
+                const Value* first;
+                std::size_t offset;
+            };
+            std::vector<LayerGrads> layers;
+            T* grads;
+
+            static const BasicGradientSink*& installed(){
+                thread_local const BasicGradientSink* sink = nullptr;
+                return sink;
+            }
+    };
+
+    template<typename T>
+    class BasicLayer{
         public:
+            using Value = BasicValue<T>;
+            using Tensor = BasicTensor<T>;
+            using Neuron = BasicNeuron<T>;
+
             int num_in;
             int num_out;
             std::string layer_name;
             std::vector<Neuron> neurons;
             std::vector<std::shared_ptr<Value>> params;
 
-            Layer(int num_in, int num_out, std::string layer_name = "connected")
-                : num_in(num_in), num_out(num_out), layer_name(layer_name){
-                for(size_t i=0; i<num_out; ++i){
-                    Neuron n(num_in);
-                    neurons.push_back(n);
+            BasicLayer(int num_in, int num_out, std::string layer_name = "connected")
+                : BasicLayer(num_in, num_out, std::move(layer_name), InitOptions{Init::Uniform, init::random_seed()}, 0) {}
+
+            // Layer number `layer_index` of a model initialized with init.
+            BasicLayer(int num_in, int num_out, std::string layer_name, const InitOptions& init, size_t layer_index)
+                : num_in(num_in), num_out(num_out), layer_name(std::move(layer_name)){
+                const init::LayerInit draws(init, layer_index, num_in, num_out);
+                const size_t stride = static_cast<size_t>(num_in) + 1;
+                const BasicParameterBlock<T> block(num_out*stride);
+                neurons.reserve(num_out);
+                for(size_t i=0; i<static_cast<size_t>(num_out); ++i){
+                    neurons.emplace_back(num_in, draws, i, block, i*stride);
                 }
             }
 
+            // Takes over neurons built elsewhere (see build_mlp in parallel.h).
+            BasicLayer(int num_in, std::vector<Neuron>&& neurons, std::string layer_name)
+                : num_in(num_in), num_out(static_cast<int>(neurons.size())), layer_name(std::move(layer_name)), neurons(std::move(neurons)) {}
+
             std::vector<std::shared_ptr<Value>> operator()(const std::vector<std::shared_ptr<Value>> &x){
-                assert(("input size must match the num_in", num_in == x.size()));
+                assert(("input size must match the num_in", static_cast<size_t>(num_in) == x.size()));
                 std::vector<std::shared_ptr<Value>> outputs;
-                for(size_t i=0; i<num_out; ++i){
+                for(size_t i=0; i<neurons.size(); ++i){
                     outputs.push_back(neurons[i](x));
                 }
                 return outputs;
             }
 
+            // No-grad evaluation: y (num_out) from x (num_in).
+            void predict(const T* x, T* y) const{
+                for(size_t i=0; i<neurons.size(); ++i){
+                    y[i] = neurons[i].predict(x);
+                }
+            }
+
+            //=====================================================================================================================
+            // Batched forward
+            //
+            // x is a (batch x num_in) tensor; the output is (batch x num_out). The neurons' weights are packed
+            // into one row-major matrix and the whole batch goes through the dense kernels, so the layer adds a
+            // single node to the graph regardless of batch size. Backward scatters the weight gradients back into
+            // each neuron's ws/b Values, which stay the parameters of record.
+            //=====================================================================================================================
+
+            std::shared_ptr<Tensor> operator()(const std::shared_ptr<Tensor> &x){
+                assert(("input size must match the num_in", static_cast<size_t>(num_in) == x->cols));
+                const size_t n = x->rows;
+                const size_t num_in = this->num_in, num_out = this->num_out;
+
+                // Packed copy of the weights the batch was evaluated with, shared by the forward and backward closures.
+                struct Packed{
+                    std::vector<Value*> params;     // ws row-major, then the biases
+                    std::vector<T> W, b;
+                };
+                auto packed = std::make_shared<Packed>();
+                packed->params.reserve(num_out*(num_in+1));
+                for(size_t j=0; j<num_out; ++j){
+                    for(size_t i=0; i<num_in; ++i){
+                        packed->params.push_back(neurons[j].ws[i].get());
+                    }
+                }
+                for(size_t j=0; j<num_out; ++j){
+                    packed->params.push_back(neurons[j].b.get());
+                }
+                packed->W.resize(num_out*num_in);
+                packed->b.resize(num_out);
+
+                auto output = std::make_shared<Tensor>(n, num_out, Op::Layer, std::vector<std::shared_ptr<Value>>{x}, layer_name);
+
+                output->forward_prop = [x = x.get(), packed, out = output.get()](){
+                    const size_t k = x->cols, m = out->cols;
+                    for(size_t i=0; i<m*k; ++i){
+                        packed->W[i] = packed->params[i]->data;
+                    }
+                    for(size_t j=0; j<m; ++j){
+                        packed->b[j] = packed->params[m*k + j]->data;
+                    }
+                    kernels::linear_tanh_forward(x->values.data(), packed->W.data(), packed->b.data(), out->values.data(), x->rows, k, m);
+                };
+                output->forward_prop();
+
+                output->back_prop = [x = x.get(), packed, out = output.get()](){
+                    const size_t k = x->cols, m = out->cols;
+                    static thread_local std::vector<T> dW, db;
+                    dW.assign(m*k, 0.0);
+                    db.assign(m, 0.0);
+                    kernels::linear_tanh_backward(x->values.data(), packed->W.data(), out->values.data(), out->grads.data(),
+                                                  x->grads.data(), dW.data(), db.data(), x->rows, k, m);
+                    const auto* sink = BasicGradientSink<T>::current();
+                    if(T* grads = (sink && m) ? sink->find(packed->params[0]) : nullptr){
+                        // Neuron j's weights, then its bias, as in parameters().
+                        for(size_t j=0; j<m; ++j){
+                            T* g = grads + j*(k+1);
+                            for(size_t i=0; i<k; ++i) g[i] += dW[j*k + i];
+                            g[k] += db[j];
+                        }
+                        return;
+                    }
+                    for(size_t i=0; i<m*k; ++i){
+                        packed->params[i]->grad += dW[i];
+                    }
+                    for(size_t j=0; j<m; ++j){
+                        packed->params[m*k + j]->grad += db[j];
+                    }
+                };
+                return output;
+            }
+
             std::vector<std::shared_ptr<Value>> parameters(){
+                params.clear();
                 for(size_t i=0; i<neurons.size(); ++i){
                     auto curr_params = neurons[i].parameters();
                     params.insert(params.end(), curr_params.begin(), curr_params.end());
@@ -78,20 +282,31 @@ namespace micrograd{
             }
     };
 
-    class MLP{
+    template<typename T>
+    class BasicMLP{
         public:
+            using Value = BasicValue<T>;
+            using Tensor = BasicTensor<T>;
+            using Layer = BasicLayer<T>;
+
             std::vector<Layer> layers;
             std::vector<std::shared_ptr<Value>> params;
 
-            MLP(const std::vector<double> &num_neurons_per_layer){
+            BasicMLP(const std::vector<double> &num_neurons_per_layer)
+                : BasicMLP(num_neurons_per_layer, InitOptions{Init::Uniform, init::random_seed()}) {}
+
+            BasicMLP(const std::vector<double> &num_neurons_per_layer, const InitOptions& init){
+                layers.reserve(num_neurons_per_layer.size()-1);
                 for(size_t i=0; i<num_neurons_per_layer.size()-1; ++i){
-                    Layer layer(num_neurons_per_layer[i], num_neurons_per_layer[i+1], "connected"+std::to_string(i+1));
-                    layers.push_back(layer);
+                    layers.emplace_back(num_neurons_per_layer[i], num_neurons_per_layer[i+1], "connected"+std::to_string(i+1), init, i);
                 }
             }
 
+            explicit BasicMLP(std::vector<Layer>&& layers) : layers(std::move(layers)) {}
+
             std::vector<std::shared_ptr<Value>> operator()(const std::vector<std::shared_ptr<Value>> &x){
-                assert(("input size must match the num_in of the first layer", layers[0].num_in == x.size()));
+                assert(("input size must match the num_in of the first layer", static_cast<size_t>(layers[0].num_in) == x.size()));
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Forward);
                 std::vector<std::shared_ptr<Value>> outputs;
                 outputs = x;
                 for(size_t i=0; i<layers.size(); ++i){
@@ -100,12 +315,170 @@ namespace micrograd{
                 return outputs;
             }
 
+            // Batched forward: x is (batch x num_in), processed one layer at a time over the whole batch.
+            std::shared_ptr<Tensor> operator()(const std::shared_ptr<Tensor> &x){
+                assert(("input size must match the num_in of the first layer", static_cast<size_t>(layers[0].num_in) == x->cols));
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Forward);
+                auto outputs = x;
+                for(size_t i=0; i<layers.size(); ++i){
+                    outputs = layers[i](outputs);
+                }
+                return outputs;
+            }
+
+            //=====================================================================================================================
+            // No-grad inference
+            //
+            // Evaluates the network directly on raw buffers without allocating Value nodes; activations live in
+            // per-thread scratch buffers. Results are bit-identical to mlp(x).
+            //=====================================================================================================================
+
+            // y receives layers.back().num_out values.
+            void predict(const T* x, T* y) const{
+                static thread_local std::vector<T> a, b;
+                const T* input = x;
+                for(size_t i=0; i<layers.size(); ++i){
+                    const Layer& layer = layers[i];
+                    T* output = y;
+                    if(i+1 < layers.size()){
+                        std::vector<T>& buf = (i % 2 == 0) ? a : b;
+                        buf.resize(layer.num_out);
+                        output = buf.data();
+                    }
+                    layer.predict(input, output);
+                    input = output;
+                }
+            }
+
+            std::vector<T> predict(const std::vector<T> &x) const{
+                assert(("input size must match the num_in of the first layer", static_cast<size_t>(layers[0].num_in) == x.size()));
+                std::vector<T> y(layers.back().num_out);
+                predict(x.data(), y.data());
+                return y;
+            }
+
+            // X is (n x num_in) row-major, Y is (n x num_out).
+            void predict(const T* X, size_t n, T* Y) const{
+                const size_t num_in = layers[0].num_in, num_out = layers.back().num_out;
+                for(size_t r=0; r<n; ++r){
+                    predict(X + r*num_in, Y + r*num_out);
+                }
+            }
+
+            //=====================================================================================================================
+            // Gradient checkpointing
+            //
+            // checkpointed(x) computes the same outputs as operator()(x), but the graph only keeps the activations
+            // at segment boundaries. Each segment of consecutive layers becomes a single node. In the forward pass
+            // it runs its layers without building a graph (as predict does). In the backward pass it rebuilds the
+            // segment's graph from its saved input, backpropagates through it into the parameters and the
+            // input, and frees it again. Peak memory is then the boundary activations plus the graph of one
+            // segment, instead of the whole per-neuron graph, at the cost of a second forward pass per segment.
+            //
+            // keep lists the layers whose outputs are stored; each of them ends a segment, and so does the last
+            // layer. By default every ceil(sqrt(L))-th layer is kept, i.e. about sqrt(L) segments of sqrt(L)
+            // layers each.
+            //
+            // Segment nodes refer to this MLP's layers, so the MLP must outlive the graph.
+            //
+            // How to use:
+            //      auto y = mlp.checkpointed(x);                   // or mlp.checkpointed(x, {3, 7, 11})
+            //      auto loss = mse(y, targets);
+            //      loss->backward();
+            //=====================================================================================================================
+
+            std::vector<std::shared_ptr<Value>> checkpointed(const std::vector<std::shared_ptr<Value>> &x){
+                return checkpointed(x, default_checkpoints());
+            }
+
+            std::vector<std::shared_ptr<Value>> checkpointed(const std::vector<std::shared_ptr<Value>> &x, const std::vector<size_t> &keep){
+                assert(("input size must match the num_in of the first layer", static_cast<size_t>(layers[0].num_in) == x.size()));
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Forward);
+                std::shared_ptr<Tensor> boundary = Tensor::from_values(x);
+                size_t begin = 0;
+                for(size_t i=0; i<layers.size(); ++i){
+                    if(i+1 < layers.size() && std::find(keep.begin(), keep.end(), i) == keep.end()) continue;
+                    boundary = segment(boundary, begin, i+1);
+                    begin = i+1;
+                }
+                return boundary->to_values();
+            }
+
+            std::vector<size_t> default_checkpoints() const{
+                const size_t stride = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(layers.size()))));
+                std::vector<size_t> keep;
+                for(size_t i=stride-1; i+1<layers.size(); i+=stride){
+                    keep.push_back(i);
+                }
+                return keep;
+            }
+
             std::vector<std::shared_ptr<Value>> parameters(){
+                params.clear();
                 for(size_t i=0; i<layers.size(); ++i){
                     auto curr_params = layers[i].parameters();
                     params.insert(params.end(), curr_params.begin(), curr_params.end());
                 }
                 return params;
             }
+
+        private:
+            // One checkpoint node for layers [begin, end) applied to the (1 x num_in) input.
+            std::shared_ptr<Tensor> segment(const std::shared_ptr<Tensor> &input, size_t begin, size_t end){
+                auto output = std::make_shared<Tensor>(1, layers[end-1].num_out, Op::Checkpoint, std::vector<std::shared_ptr<Value>>{input});
+                // Layer pointers rather than this: they stay valid when the MLP is moved.
+                Layer* first = layers.data() + begin;
+                const size_t count = end - begin;
+
+                output->forward_prop = [first, count, in = input.get(), out = output.get()](){
+                    static thread_local std::vector<T> a, b;
+                    const T* x = in->values.data();
+                    for(size_t k=0; k<count; ++k){
+                        T* y = out->values.data();
+                        if(k+1 < count){
+                            std::vector<T>& buf = (k % 2 == 0) ? a : b;
+                            buf.resize(first[k].num_out);
+                            y = buf.data();
+                        }
+                        first[k].predict(x, y);
+                        x = y;
+                    }
+                };
+                output->forward_prop();
+
+                output->back_prop = [first, count, in = input.get(), out = output.get()](){
+                    std::vector<std::shared_ptr<Value>> xs;
+                    xs.reserve(in->values.size());
+                    for(T v : in->values){
+                        xs.push_back(std::make_shared<Value>(v));
+                    }
+                    auto ys = xs;
+                    for(size_t k=0; k<count; ++k){
+                        ys = first[k](ys);
+                    }
+                    // Seeds every y_j with the segment's output gradient g_j: the root g.y has dz = 1, so each
+                    // y_j receives exactly g_j.
+                    std::vector<std::shared_ptr<Value>> seeds;
+                    seeds.reserve(out->grads.size());
+                    for(T g : out->grads){
+                        seeds.push_back(std::make_shared<Value>(g));
+                    }
+                    linear(ys, seeds, std::make_shared<Value>(T(0)))->backward(/*retain_graph=*/false);
+                    for(size_t i=0; i<xs.size(); ++i){
+                        in->grads[i] += xs[i]->grad;
+                    }
+                };
+                return output;
+            }
     };
-}
\ No newline at end of file
+
+    using Neuron = BasicNeuron<double>;
+    using Layer = BasicLayer<double>;
+    using MLP = BasicMLP<double>;
+
+    using Neuronf = BasicNeuron<float>;
+    using Layerf = BasicLayer<float>;
+    using MLPf = BasicMLP<float>;
+    using GradientSink = BasicGradientSink<double>;
+    using GradientSinkf = BasicGradientSink<float>;
+}
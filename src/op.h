@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Op kinds
+    //
+    // Built-in scalar ops are dispatched on this tag, so they need neither closures nor an extra node for a
+    // constant operand (the constant is kept in Value::aux). Tensor-level and custom nodes set their own
+    // forward_prop/back_prop closures.
+    //=====================================================================================================================
+
+    enum class Op : std::uint8_t{
+        None,       // leaf
+        Add,        // prevs[0] + prevs[1]
+        AddConst,   // prevs[0] + aux
+        Mul,        // prevs[0] * prevs[1]
+        MulConst,   // prevs[0] * aux
+        Pow,        // prevs[0] ^ aux
+        PowBase,    // aux ^ prevs[0]
+        Exp,        // exp(prevs[0])
+        Tanh,       // tanh(prevs[0])
+        Linear,     // b + sum_i w_i*x_i, prevs = [w_0..w_n-1, x_0..x_n-1, b]
+        LinearTanh, // tanh(b + sum_i w_i*x_i), same prevs as Linear
+        Sum,        // sum_i prevs[i]
+        Mean,       // sum_i prevs[i] / n
+        Mse,        // sum_i (p_i - t_i)^2 / n, prevs = [p_0..p_n-1, t_0..t_n-1]
+        Index,      // one element of a Tensor
+        Stack,      // Tensor gathered from scalar Values
+        Layer,      // batched Layer forward
+        Dense,      // DenseLayer forward
+        Checkpoint, // MLP layers recomputed during backward (gradient checkpointing)
+        Custom      // driven by the node's closures
+    };
+
+    inline const char* op_name(Op op){
+        switch(op){
+            case Op::None:      return "";
+            case Op::Add:
+            case Op::AddConst:  return "+";
+            case Op::Mul:
+            case Op::MulConst:  return "*";
+            case Op::Pow:
+            case Op::PowBase:   return "^";
+            case Op::Exp:       return "exp";
+            case Op::Tanh:      return "tanh";
+            case Op::Linear:    return "w.x+b";
+            case Op::LinearTanh:return "tanh(w.x+b)";
+            case Op::Sum:       return "sum";
+            case Op::Mean:      return "mean";
+            case Op::Mse:       return "mse";
+            case Op::Index:     return "[]";
+            case Op::Stack:     return "stack";
+            case Op::Layer:     return "layer";
+            case Op::Dense:     return "dense";
+            case Op::Checkpoint:return "checkpoint";
+            case Op::Custom:    return "custom";
+        }
+        return "";
+    }
+
+    // Ops from Index on run the node's forward_prop/back_prop closures; the ones before it are built in.
+    inline bool uses_closures(Op op){
+        return op >= Op::Index;
+    }
+
+    constexpr std::size_t kNumOps = static_cast<std::size_t>(Op::Custom) + 1;
+}
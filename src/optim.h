@@ -0,0 +1,299 @@
+#pragma once
+
+#include <vector>
+#include <new>
+#include <cmath>
+#include <cstdint>
+
+#include "block.h"
+#include "params.h"
+#include "tensor.h"
+#include "kernels.h"
+
+namespace micrograd{
+
+    // Minimal allocator handing out storage aligned to Alignment bytes.
+    template<typename T, std::size_t Alignment = 64>
+    struct AlignedAllocator{
+        using value_type = T;
+        template<typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+        AlignedAllocator() = default;
+        template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+        T* allocate(std::size_t n){
+            return static_cast<T*>(::operator new(n*sizeof(T), std::align_val_t(Alignment)));
+        }
+        void deallocate(T* p, std::size_t){
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+
+        template<typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+        template<typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+    };
+
+    template<typename T>
+    using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+    //=====================================================================================================================
+    // Parameter store
+    //
+    // Indexes the parameters an optimizer updates, without copying them: the parameters stay the storage, and
+    // optimizers update their data and clear their grads in place. Parameters are registered once (scalar
+    // Values, e.g. mlp.parameters(), or tensors, e.g. DenseLayer::parameters()) and numbered in registration
+    // order; an optimizer keeps its per-parameter state (velocity, Adam moments) in contiguous, 64-byte aligned
+    // arrays under those numbers. The store and the optimizers are templated on the scalar type: ParameterStore,
+    // SGD, Momentum and Adam for double models, ParameterStoref, SGDf, Momentumf and Adamf for MLPf and the
+    // other float ones.
+    //
+    // Scalar Values registered one after the other that are also consecutive slots of a ParameterBlock
+    // (params.h), value_stride bytes apart, form a run. A layer's parameters share one block, so
+    // mlp.parameters() registers one run per layer, and an update walks it with a fixed stride. Tensors are
+    // contiguous already.
+    //
+    // Scalar parameters are not moved into structure-of-arrays storage: a Value owns its data and grad, and
+    // every graph op reads them through the Value, so backing them with arrays would mean changing the node
+    // type itself. Runs are therefore updated by a strided scalar loop, and their grads are cleared in that
+    // same loop rather than by one memset. Only tensors get contiguous, vectorized updates.
+    //
+    // How to use:
+    //      ParameterStore store;
+    //      store.add(mlp.parameters());
+    //      Adam opt(store, 1e-3);
+    //      while(training){
+    //          loss->backward();
+    //          opt.step();             // update in place, clear the grads
+    //      }
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicParameterStore{
+        public:
+            using Value = BasicValue<T>;
+            using Tensor = BasicTensor<T>;
+
+            // count Values starting at first, value_stride bytes apart; the first is parameter number offset.
+            struct ValueRun{
+                static constexpr size_t value_stride = BasicParameterBlock<T>::value_stride;
+
+                Value* first;
+                size_t count;
+                size_t offset;
+
+                Value& operator[](size_t i) const{
+                    return *reinterpret_cast<Value*>(reinterpret_cast<unsigned char*>(first) + i*value_stride);
+                }
+            };
+
+            struct TensorSlot{
+                std::shared_ptr<Tensor> tensor;
+                size_t offset;
+            };
+
+            size_t size() const { return count; }
+
+            void add(const std::vector<std::shared_ptr<Value>>& params){
+                for(const auto& p : params){
+                    if(!runs_.empty() && runs_.back().offset + runs_.back().count == count &&
+                       follows(runs_.back()[runs_.back().count - 1], *p)){
+                        ++runs_.back().count;
+                    } else{
+                        runs_.push_back({p.get(), 1, count});
+                    }
+                    values.push_back(p);
+                    ++count;
+                }
+            }
+
+            void add(const std::vector<std::shared_ptr<Tensor>>& params){
+                for(const auto& t : params){
+                    tensors_.push_back({t, count});
+                    count += t->size();
+                }
+            }
+
+            const std::vector<ValueRun>& runs() const { return runs_; }
+            const std::vector<TensorSlot>& tensors() const { return tensors_; }
+
+            void zero_grad(){
+                for(const ValueRun& run : runs_){
+                    for(size_t i=0; i<run.count; ++i) run[i].grad = T(0);
+                }
+                for(const TensorSlot& slot : tensors_) slot.tensor->zero_grad();
+            }
+
+        private:
+            // Whether b is the Value in the slot after a's.
+            static bool follows(const Value& a, const Value& b){
+                return reinterpret_cast<std::uintptr_t>(&b) - reinterpret_cast<std::uintptr_t>(&a) == ValueRun::value_stride;
+            }
+
+            std::vector<std::shared_ptr<Value>> values;     // keeps the registered Values alive
+            std::vector<ValueRun> runs_;
+            std::vector<TensorSlot> tensors_;
+            size_t count = 0;
+    };
+
+    //=====================================================================================================================
+    // Optimizers
+    //
+    // Each step() applies the update rule to every registered parameter in place, one pass per run of Values
+    // and one vectorized pass per tensor (kernels.h), and leaves all their grads at zero. Hyperparameters and
+    // optimizer state are in the model's scalar type.
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicOptimizer{
+        public:
+            using Value = BasicValue<T>;
+            using ParameterStore = BasicParameterStore<T>;
+            using ValueRun = typename ParameterStore::ValueRun;
+
+            explicit BasicOptimizer(ParameterStore& store) : store(store) {}
+            virtual ~BasicOptimizer() = default;
+
+            void step(){
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Update);
+                prepare(store.size());
+                for(const auto& run : store.runs()){
+                    update(run);
+                }
+                for(const auto& slot : store.tensors()){
+                    update(slot.tensor->values.data(), slot.tensor->grads.data(), slot.tensor->size(), slot.offset);
+                    slot.tensor->zero_grad();
+                }
+            }
+
+        protected:
+            ParameterStore& store;
+
+            // Called once per step with the number of parameters, before any update.
+            virtual void prepare(size_t) {}
+            // The Values of a run, parameters run.offset .. run.offset+run.count-1; also clears their grads.
+            virtual void update(const ValueRun& run) = 0;
+            // n contiguous parameters of a tensor, parameters offset .. offset+n-1.
+            virtual void update(T* w, const T* g, size_t n, size_t offset) = 0;
+    };
+
+    // w -= lr * g
+    template<typename T>
+    class BasicSGD : public BasicOptimizer<T>{
+        public:
+            using typename BasicOptimizer<T>::Value;
+            using typename BasicOptimizer<T>::ParameterStore;
+            using typename BasicOptimizer<T>::ValueRun;
+
+            T lr;
+
+            BasicSGD(ParameterStore& store, T lr) : BasicOptimizer<T>(store), lr(lr) {}
+
+        protected:
+            void update(const ValueRun& run) override{
+                for(size_t i=0; i<run.count; ++i){
+                    Value& p = run[i];
+                    p.data += -lr*p.grad;
+                    p.grad = T(0);
+                }
+            }
+
+            void update(T* w, const T* g, size_t n, size_t) override{
+                kernels::axpy(-lr, g, w, n);
+            }
+    };
+
+    // v = mu * v + g; w -= lr * v
+    template<typename T>
+    class BasicMomentum : public BasicOptimizer<T>{
+        public:
+            using typename BasicOptimizer<T>::Value;
+            using typename BasicOptimizer<T>::ParameterStore;
+            using typename BasicOptimizer<T>::ValueRun;
+
+            T lr;
+            T mu;
+
+            BasicMomentum(ParameterStore& store, T lr, T mu = T(0.9))
+                : BasicOptimizer<T>(store), lr(lr), mu(mu), velocity(store.size(), T(0)) {}
+
+        protected:
+            void prepare(size_t n) override{
+                velocity.resize(n, T(0));
+            }
+
+            void update(const ValueRun& run) override{
+                T* v = velocity.data() + run.offset;
+                for(size_t i=0; i<run.count; ++i){
+                    Value& p = run[i];
+                    v[i] = mu*v[i] + p.grad;
+                    p.data += -lr*v[i];
+                    p.grad = T(0);
+                }
+            }
+
+            void update(T* w, const T* g, size_t n, size_t offset) override{
+                kernels::momentum_step(lr, mu, g, velocity.data() + offset, w, n);
+            }
+
+        private:
+            aligned_vector<T> velocity;
+    };
+
+    // Adam with bias correction.
+    template<typename T>
+    class BasicAdam : public BasicOptimizer<T>{
+        public:
+            using typename BasicOptimizer<T>::Value;
+            using typename BasicOptimizer<T>::ParameterStore;
+            using typename BasicOptimizer<T>::ValueRun;
+
+            T lr;
+            T beta1;
+            T beta2;
+            T eps;
+
+            BasicAdam(ParameterStore& store, T lr = T(1e-3), T beta1 = T(0.9), T beta2 = T(0.999), T eps = T(1e-8))
+                : BasicOptimizer<T>(store), lr(lr), beta1(beta1), beta2(beta2), eps(eps), m(store.size(), T(0)), v(store.size(), T(0)) {}
+
+        protected:
+            void prepare(size_t n) override{
+                m.resize(n, T(0));
+                v.resize(n, T(0));
+                ++t;
+                step_size = lr * std::sqrt(1 - std::pow(beta2, t)) / (1 - std::pow(beta1, t));
+            }
+
+            void update(const ValueRun& run) override{
+                T* mp = m.data() + run.offset;
+                T* vp = v.data() + run.offset;
+                for(size_t i=0; i<run.count; ++i){
+                    Value& p = run[i];
+                    const T g = p.grad;
+                    mp[i] = beta1*mp[i] + (1 - beta1)*g;
+                    vp[i] = beta2*vp[i] + (1 - beta2)*g*g;
+                    p.data += -step_size * mp[i] / (std::sqrt(vp[i]) + eps);
+                    p.grad = T(0);
+                }
+            }
+
+            void update(T* w, const T* g, size_t n, size_t offset) override{
+                kernels::adam_step(step_size, beta1, beta2, eps, g, m.data() + offset, v.data() + offset, w, n);
+            }
+
+        private:
+            aligned_vector<T> m;
+            aligned_vector<T> v;
+            std::int64_t t = 0;
+            T step_size = T(0);
+    };
+
+    using ParameterStore = BasicParameterStore<double>;
+    using ParameterStoref = BasicParameterStore<float>;
+    using Optimizer = BasicOptimizer<double>;
+    using Optimizerf = BasicOptimizer<float>;
+    using SGD = BasicSGD<double>;
+    using SGDf = BasicSGD<float>;
+    using Momentum = BasicMomentum<double>;
+    using Momentumf = BasicMomentum<float>;
+    using Adam = BasicAdam<double>;
+    using Adamf = BasicAdam<float>;
+}
@@ -0,0 +1,513 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "nn.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Thread pool
+    //
+    // A fixed set of workers that run one parallel_for at a time. The calling thread blocks until every
+    // index of the job has been processed.
+    //=====================================================================================================================
+
+    class ThreadPool{
+        public:
+            explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency()){
+                num_threads = std::max<size_t>(1, num_threads);
+                for(size_t t=0; t<num_threads; ++t){
+                    workers.emplace_back([this](){ worker_loop(); });
+                }
+            }
+
+            ~ThreadPool(){
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                job_ready.notify_all();
+                for(auto& w : workers){
+                    w.join();
+                }
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            size_t size() const { return workers.size(); }
+
+            // Runs fn(i) for every i in [0, n) on the pool's workers.
+            void parallel_for(size_t n, const std::function<void(size_t)>& fn){
+                if(n == 0) return;
+                std::unique_lock<std::mutex> lock(mutex);
+                job = &fn;
+                job_size = n;
+                next_index = 0;
+                remaining = n;
+                ++generation;
+                job_ready.notify_all();
+                job_done.wait(lock, [this](){ return remaining == 0; });
+                job = nullptr;
+            }
+
+        private:
+            std::vector<std::thread> workers;
+            std::mutex mutex;
+            std::condition_variable job_ready;
+            std::condition_variable job_done;
+            const std::function<void(size_t)>* job = nullptr;
+            size_t job_size = 0;
+            size_t next_index = 0;
+            size_t remaining = 0;
+            size_t generation = 0;
+            bool stopping = false;
+
+            void worker_loop(){
+                size_t seen = 0;
+                std::unique_lock<std::mutex> lock(mutex);
+                while(true){
+                    job_ready.wait(lock, [&](){ return stopping || (generation != seen && job && next_index < job_size); });
+                    if(stopping) return;
+                    seen = generation;
+                    while(job && next_index < job_size){
+                        const size_t i = next_index++;
+                        const auto* fn = job;
+                        lock.unlock();
+                        (*fn)(i);
+                        lock.lock();
+                        if(--remaining == 0){
+                            job_done.notify_all();
+                        }
+                    }
+                }
+            }
+    };
+
+    //=====================================================================================================================
+    // Parallel model construction
+    //
+    // build_mlp(shape, init, pool) returns the same model as MLP(shape, init), bit for bit, with the neurons
+    // built on the pool's workers. Each layer gets its ParameterBlock up front and is cut into chunks of about
+    // kParamsPerChunk parameters. Every chunk builds its neurons in place, into their own slots of the block,
+    // and the chunks are then moved into their layers in order. Since each parameter only depends on (seed,
+    // layer, index) (see init.h), the number of workers does not matter.
+    //
+    // How to use:
+    //      ThreadPool pool;
+    //      MLP mlp = build_mlp({1024, 4096, 2048, 10}, init, pool);
+    //      MLPf mlpf = build_mlp<float>({1024, 4096, 2048, 10}, init, pool);
+    //=====================================================================================================================
+
+    template<typename T = double>
+    BasicMLP<T> build_mlp(const std::vector<double>& num_neurons_per_layer, const InitOptions& init, ThreadPool& pool){
+        using Neuron = BasicNeuron<T>;
+        using Layer = BasicLayer<T>;
+        constexpr size_t kParamsPerChunk = size_t(1) << 16;
+
+        struct Chunk{
+            size_t layer;
+            size_t begin;
+            size_t end;
+        };
+
+        const size_t num_layers = num_neurons_per_layer.size() - 1;
+        std::vector<init::LayerInit> draws;
+        std::vector<BasicParameterBlock<T>> blocks;
+        std::vector<Chunk> chunks;
+        draws.reserve(num_layers);
+        blocks.reserve(num_layers);
+        for(size_t l=0; l<num_layers; ++l){
+            const int num_in = static_cast<int>(num_neurons_per_layer[l]);
+            const int num_out = static_cast<int>(num_neurons_per_layer[l+1]);
+            draws.emplace_back(init, l, num_in, num_out);
+            blocks.emplace_back(static_cast<size_t>(num_out) * (num_in + 1));
+            const size_t per_chunk = std::max<size_t>(1, kParamsPerChunk / (num_in + 1));
+            for(size_t begin=0; begin<static_cast<size_t>(num_out); begin+=per_chunk){
+                chunks.push_back({l, begin, std::min<size_t>(begin + per_chunk, num_out)});
+            }
+        }
+
+        std::vector<std::vector<Neuron>> built(chunks.size());
+        pool.parallel_for(chunks.size(), [&](size_t c){
+            const Chunk& chunk = chunks[c];
+            const int num_in = static_cast<int>(num_neurons_per_layer[chunk.layer]);
+            built[c].reserve(chunk.end - chunk.begin);
+            for(size_t j=chunk.begin; j<chunk.end; ++j){
+                built[c].emplace_back(num_in, draws[chunk.layer], j, blocks[chunk.layer], j*(num_in + 1));
+            }
+        });
+
+        std::vector<Layer> layers;
+        layers.reserve(num_layers);
+        size_t c = 0;
+        for(size_t l=0; l<num_layers; ++l){
+            std::vector<Neuron> neurons;
+            neurons.reserve(static_cast<size_t>(num_neurons_per_layer[l+1]));
+            for(; c<chunks.size() && chunks[c].layer == l; ++c){
+                for(auto& neuron : built[c]){
+                    neurons.push_back(std::move(neuron));
+                }
+            }
+            layers.emplace_back(static_cast<int>(num_neurons_per_layer[l]), std::move(neurons), "connected"+std::to_string(l+1));
+        }
+        return BasicMLP<T>(std::move(layers));
+    }
+
+    //=====================================================================================================================
+    // Parallel backward
+    //
+    // Runs the same sweep as Value::backward() (with the graph retained) on a thread pool, and produces
+    // bitwise identical gradients for any number of threads.
+    //
+    // The reverse topological order is cut into segments at nodes driven by closures (tensor ops, Layer and
+    // custom ops). Those run one at a time, in their sequential position, between segments. Inside a segment
+    // the built-in scalar ops are scheduled by dependency level: a node's level is one more than the highest
+    // level of the segment nodes that consume it, so all nodes of a level are independent. Instead of every
+    // consumer pushing into its prevs, each node of a level pulls its consumers' contributions, in exactly the
+    // order the sequential sweep would have added them (Value::accumulate_into). A gradient is therefore only
+    // ever written by the one task that owns it: no locks, no atomics, and no reordering of floating-point sums.
+    //
+    // The schedule is built once per graph. Like a Plan, it holds raw pointers into the graph and stays valid
+    // for as long as the graph is alive and unchanged; run() can be called again after every forward replay.
+    //
+    // How to use:
+    //      ThreadPool pool(8);
+    //      ParallelBackward sweep(loss, pool);
+    //      sweep.run();                        // same gradients as loss->backward()
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicParallelBackward{
+        public:
+            using Value = BasicValue<T>;
+
+            // Levels with fewer edges than this are not worth a round trip through the pool.
+            static constexpr size_t kMinParallelEdges = 4096;
+
+            BasicParallelBackward(std::shared_ptr<Value> root, ThreadPool& pool)
+                : root(std::move(root)), pool(pool){
+                if(pool.size() > 1) build();
+            }
+
+            void run(){
+                // Pulling reads every consumer's operands once per target, about twice the memory traffic of
+                // the sequential sweep, so a single worker is better off running that.
+                if(pool.size() < 2){
+                    root->backward();
+                    return;
+                }
+
+                const std::vector<Value*>& topo = root->topological_order();
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Backward);
+
+                for(Value* node : topo){
+                    if(!node->prevs.empty()) node->zero_grad();
+                }
+                root->grad = T(1);
+
+                for(const Step& step : steps){
+                    if(step.closure){
+                        step.closure->propagate_backward();
+                        continue;
+                    }
+                    for(size_t l=step.level_begin; l<step.level_end; ++l){
+                        run_level(levels[l]);
+                    }
+                }
+            }
+
+            size_t num_levels() const { return levels.size(); }
+
+        private:
+            // Consumer whose backward step contributes to a target, and the target's operand slot in it.
+            struct Edge{
+                Value* consumer;
+                size_t slot;
+            };
+
+            // One target of a level and its incoming edges, in sequential order.
+            struct Task{
+                Value* target;
+                size_t edge_begin;
+                size_t edge_end;
+            };
+
+            struct Level{
+                size_t task_begin;
+                size_t task_end;
+                size_t num_edges;
+            };
+
+            // Either a closure node, or a segment's range of levels.
+            struct Step{
+                Value* closure;
+                size_t level_begin;
+                size_t level_end;
+            };
+
+            std::shared_ptr<Value> root;
+            ThreadPool& pool;
+            std::vector<Edge> edges;
+            std::vector<Task> tasks;
+            std::vector<Level> levels;
+            std::vector<Step> steps;
+
+            void build(){
+                const std::vector<Value*>& topo = root->topological_order();
+                for(size_t i=0; i<topo.size(); ++i){
+                    topo[i]->pass_index = static_cast<std::uint32_t>(i);
+                }
+
+                // Per-node scratch, indexed by topological position. A node belongs to the segment being
+                // built when its stamp equals that segment's number.
+                std::vector<size_t> stamp(topo.size(), 0);
+                std::vector<size_t> level(topo.size(), 0);
+                std::vector<size_t> local(topo.size(), 0);
+                size_t segment = 0;
+
+                size_t end = topo.size();
+                while(end > 0){
+                    if(uses_closures(topo[end-1]->op)){
+                        steps.push_back({topo[end-1], 0, 0});
+                        --end;
+                        continue;
+                    }
+                    size_t begin = end;
+                    while(begin > 0 && !uses_closures(topo[begin-1]->op)) --begin;
+                    build_segment(topo, begin, end, ++segment, stamp, level, local);
+                    end = begin;
+                }
+            }
+
+            // Schedules the scalar nodes topo[begin, end), which the sequential sweep visits from end-1 down.
+            void build_segment(const std::vector<Value*>& topo, size_t begin, size_t end, size_t segment,
+                               std::vector<size_t>& stamp, std::vector<size_t>& level, std::vector<size_t>& local){
+                struct RawEdge{
+                    size_t target;      // index into targets
+                    Edge edge;
+                };
+                std::vector<size_t> targets;
+                std::vector<RawEdge> raw;
+                size_t max_level = 0;
+
+                for(size_t i=end; i-- > begin;){
+                    Value* consumer = topo[i];
+                    if(consumer->prevs.empty()) continue;
+                    // A consumer nothing in this segment feeds has its final gradient already.
+                    const size_t consumer_level = (stamp[i] == segment) ? level[i] : 0;
+                    consumer->for_each_backward_slot([&](size_t slot){
+                        const size_t t = consumer->prevs[slot]->pass_index;
+                        if(stamp[t] != segment){
+                            stamp[t] = segment;
+                            level[t] = 0;
+                            local[t] = targets.size();
+                            targets.push_back(t);
+                        }
+                        level[t] = std::max(level[t], consumer_level + 1);
+                        max_level = std::max(max_level, level[t]);
+                        raw.push_back({local[t], {consumer, slot}});
+                    });
+                }
+                if(targets.empty()) return;
+
+                // Group the edges by target, keeping their sequential order.
+                std::vector<size_t> edge_offset(targets.size() + 1, 0);
+                for(const RawEdge& r : raw) ++edge_offset[r.target + 1];
+                for(size_t k=0; k<targets.size(); ++k) edge_offset[k+1] += edge_offset[k];
+                const size_t edge_base = edges.size();
+                edges.resize(edge_base + raw.size());
+                std::vector<size_t> fill(edge_offset.begin(), edge_offset.end() - 1);
+                for(const RawEdge& r : raw) edges[edge_base + fill[r.target]++] = r.edge;
+
+                // Then the targets by level. Levels start at 1; level 0 holds the nodes nothing here feeds.
+                std::vector<size_t> task_offset(max_level + 2, 0);
+                for(size_t t : targets) ++task_offset[level[t] + 1];
+                for(size_t l=0; l<=max_level; ++l) task_offset[l+1] += task_offset[l];
+                const size_t task_base = tasks.size();
+                tasks.resize(task_base + targets.size());
+                fill.assign(task_offset.begin(), task_offset.end() - 1);
+                for(size_t k=0; k<targets.size(); ++k){
+                    const size_t t = targets[k];
+                    tasks[task_base + fill[level[t]]++] = {topo[t], edge_base + edge_offset[k], edge_base + edge_offset[k+1]};
+                }
+
+                const size_t level_begin = levels.size();
+                for(size_t l=1; l<=max_level; ++l){
+                    Level lv{task_base + task_offset[l], task_base + task_offset[l+1], 0};
+                    for(size_t k=lv.task_begin; k<lv.task_end; ++k) lv.num_edges += tasks[k].edge_end - tasks[k].edge_begin;
+                    levels.push_back(lv);
+                }
+                steps.push_back({nullptr, level_begin, levels.size()});
+            }
+
+            void run_tasks(size_t begin, size_t end){
+                for(size_t k=begin; k<end; ++k){
+                    const Task& task = tasks[k];
+                    T g = task.target->grad;
+                    for(size_t e=task.edge_begin; e<task.edge_end; ++e){
+                        edges[e].consumer->accumulate_into(g, edges[e].slot);
+                    }
+                    task.target->grad = g;
+                }
+            }
+
+            void run_level(const Level& level){
+                const size_t n = level.task_end - level.task_begin;
+                if(pool.size() < 2 || n < 2 || level.num_edges < kMinParallelEdges){
+                    run_tasks(level.task_begin, level.task_end);
+                    return;
+                }
+                const size_t chunks = std::min(n, 4*pool.size());
+                pool.parallel_for(chunks, [&](size_t c){
+                    run_tasks(level.task_begin + n*c/chunks, level.task_begin + n*(c+1)/chunks);
+                });
+            }
+    };
+
+    using ParallelBackward = BasicParallelBackward<double>;
+    using ParallelBackwardf = BasicParallelBackward<float>;
+
+    //=====================================================================================================================
+    // Data-parallel trainer
+    //
+    // Splits a mini-batch into contiguous shards, one per pool thread unless a count is given. Every shard
+    // builds its graph on the master model itself, reading its parameters in place, and backpropagates into a
+    // gradient array of its own through a GradientSink (nn.h) instead of into the parameters' grads. The shards
+    // run on a thread pool, a worker taking as many as it is handed. Their arrays are then combined with a
+    // pairwise tree reduction in a fixed order and accumulated into the master's parameter grads. With a shard
+    // count given at construction the result is the same bit for bit for any number of threads.
+    //
+    // loss_fn must run the model on a Tensor (the batched Layer path), which reaches the parameters through
+    // the layers rather than as graph operands, and build its inputs and constants as fresh Values (or a
+    // Tensor::from_data) on every call. Every step checks that no shard graph holds a parameter as a node and
+    // that no two shards share a node, and throws std::runtime_error otherwise.
+    //
+    // How to use:
+    //      DataParallelTrainer trainer(mlp);               // one shard per thread, one thread per core
+    //      while(training){
+    //          for(auto& p : params) p->grad = 0.0;
+    //          double loss = trainer.compute_gradients(batch_size, [&](MLP& model, size_t begin, size_t end){
+    //              ... build and return the loss of samples [begin, end) with model(Tensor) ...
+    //          });
+    //          for(auto& p : params) p->data += -0.1*p->grad;
+    //      }
+    //=====================================================================================================================
+
+    class DataParallelTrainer{
+        public:
+            // Builds the loss of samples [begin, end) on the master model, from leaves of its own.
+            using LossFn = std::function<std::shared_ptr<Value>(MLP& model, size_t begin, size_t end)>;
+
+            // num_shards == 0: one shard per pool thread.
+            explicit DataParallelTrainer(MLP& model, size_t num_shards = 0, size_t num_threads = std::thread::hardware_concurrency())
+                : master(model), pool(num_threads){
+                if(num_shards == 0) num_shards = pool.size();
+                master_params = master.parameters();
+                for(const auto& p : master_params) param_set.insert(p.get());
+
+                grad_buffers.assign(num_shards, std::vector<double>(master_params.size(), 0.0));
+                for(auto& grads : grad_buffers) sinks.emplace_back(master, grads.data());
+                shard_losses.assign(num_shards, 0.0);
+                losses.resize(num_shards);
+            }
+
+            size_t num_shards() const { return grad_buffers.size(); }
+
+            // Accumulates the gradient of the total loss over samples [0, batch_size) into the master's
+            // parameter grads and returns the total loss.
+            double compute_gradients(size_t batch_size, const LossFn& loss_fn){
+                const size_t num = num_shards();
+                const size_t P = master_params.size();
+
+                pool.parallel_for(num, [&](size_t s){
+                    // Shard boundaries depend only on batch_size and the shard count.
+                    const size_t begin = batch_size*s / num;
+                    const size_t end = batch_size*(s+1) / num;
+                    shard_losses[s] = 0.0;
+                    if(begin < end){
+                        losses[s] = loss_fn(master, begin, end);
+                        shard_losses[s] = losses[s]->data;
+                    }
+                });
+                if(const char* error = check_shards()){
+                    for(auto& loss : losses) loss.reset();
+                    throw std::runtime_error(std::string("trainer: ") + error);
+                }
+
+                pool.parallel_for(num, [&](size_t s){
+                    std::fill(grad_buffers[s].begin(), grad_buffers[s].end(), 0.0);
+                    if(losses[s]){
+                        GradientSink::Scope scope(sinks[s]);
+                        losses[s]->backward(/*retain_graph=*/false);
+                        losses[s].reset();
+                    }
+                });
+
+                // Pairwise tree reduction: grad_buffers[0] ends up holding the sum of all shards.
+                for(size_t stride=1; stride<num; stride*=2){
+                    const size_t pairs = (num + 2*stride - 1) / (2*stride);
+                    pool.parallel_for(pairs, [&](size_t k){
+                        const size_t dst = 2*stride*k;
+                        const size_t src = dst + stride;
+                        if(src >= num) return;
+                        auto& a = grad_buffers[dst];
+                        const auto& b = grad_buffers[src];
+                        for(size_t i=0; i<P; ++i){
+                            a[i] += b[i];
+                        }
+                    });
+                }
+
+                const auto& total = grad_buffers[0];
+                for(size_t i=0; i<P; ++i){
+                    master_params[i]->grad += total[i];
+                }
+
+                double loss = 0.0;
+                for(double l : shard_losses){
+                    loss += l;
+                }
+                return loss;
+            }
+
+        private:
+            MLP& master;
+            ThreadPool pool;
+            std::vector<std::shared_ptr<Value>> master_params;
+            std::unordered_set<const Value*> param_set;
+            std::vector<std::vector<double>> grad_buffers;
+            std::vector<GradientSink> sinks;                // one per shard, over its grad buffer
+            std::vector<double> shard_losses;
+            std::vector<std::shared_ptr<Value>> losses;
+            std::unordered_map<const Value*, size_t> owner;
+
+            // Null if the shard graphs can be backpropagated concurrently, else what is wrong with them. Runs on
+            // the calling thread only.
+            const char* check_shards(){
+                owner.clear();
+                for(size_t s=0; s<losses.size(); ++s){
+                    if(!losses[s]) continue;
+                    for(const Value* node : losses[s]->topological_order()){
+                        if(param_set.count(node)) return "loss_fn must run the model on a Tensor: a shard graph holds a parameter as a node";
+                        if(!owner.emplace(node, s).second) return "loss_fn must build its graph from leaves of its own: shards may not share nodes";
+                    }
+                }
+                return nullptr;
+            }
+    };
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "block.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Parameter blocks
+    //
+    // A ParameterBlock is one allocation holding the leaf Values of a layer, each in a fixed-size slot.
+    // make(slot, data) is std::allocate_shared with an allocator that hands out the slot's memory, so the
+    // Value and its control block sit together in the block, parameters behave like any other Value
+    // (shared_from_this, graph ownership), and a layer costs one allocation instead of one per parameter.
+    // Slot i holds parameter i, so the parameters of a layer are evenly spaced, value_stride bytes apart:
+    // the bias follows the last weight of its neuron and precedes the next neuron's first weight. The
+    // optimizers (optim.h) walk such runs of Values in place.
+    //
+    // Only the size of the control block matters, not its layout: a slot has room for the Value plus
+    // kControlBytes of counts, vtable pointer and allocator, and allocate() refuses to compile for a standard
+    // library whose control block is larger. Different slots may be made concurrently from several threads;
+    // each slot is made at most once. The memory is freed when the handle and every Value made from it are
+    // gone, in any order.
+    //
+    // How to use:
+    //      ParameterBlock block(num_out * (num_in + 1));
+    //      auto w = block.make(0, 0.5);                    // std::shared_ptr<Value>
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicParameterBlock{
+        public:
+            using Value = BasicValue<T>;
+
+            explicit BasicParameterBlock(std::size_t capacity){
+                const std::size_t bytes = kSlotsOffset + capacity*kSlotBytes;
+                void* memory = ::operator new(bytes, std::align_val_t(kAlignment));
+                // Large blocks are fresh mappings, and faulting them in 4 KB at a time dominates construction.
+                if(bytes >= kHugePage) ::madvise(memory, bytes, MADV_HUGEPAGE);
+                header = new (memory) Header{{1}, capacity};
+            }
+
+            ~BasicParameterBlock(){
+                if(header) release(header);
+            }
+
+            BasicParameterBlock(const BasicParameterBlock&) = delete;
+            BasicParameterBlock& operator=(const BasicParameterBlock&) = delete;
+
+            BasicParameterBlock(BasicParameterBlock&& other) noexcept : header(other.header){
+                other.header = nullptr;
+            }
+
+            std::size_t capacity() const { return header->capacity; }
+
+            // Constructs the leaf Value of slot in place.
+            std::shared_ptr<Value> make(std::size_t slot, T data) const{
+                assert(("parameter slot out of range", slot < header->capacity));
+                header->refs.fetch_add(1, std::memory_order_relaxed);
+                return std::allocate_shared<Value>(SlotAllocator<Value>{header, slot}, data);
+            }
+
+        private:
+            // Room in each slot for the control block's own fields next to the Value. Checked in allocate().
+            static constexpr std::size_t kControlBytes = 48;
+            static constexpr std::size_t kSlotAlignment = 16;
+            static constexpr std::size_t kAlignment = 64;
+            static constexpr std::size_t kHugePage = std::size_t(2) << 20;
+
+        public:
+            // Bytes from the Value of one slot to the Value of the next.
+            static constexpr std::size_t value_stride = (sizeof(Value) + kControlBytes + kSlotAlignment - 1) / kSlotAlignment * kSlotAlignment;
+
+        private:
+            static constexpr std::size_t kSlotBytes = value_stride;
+
+            struct Header{
+                std::atomic<std::size_t> refs;      // the handle, plus one per Value made and not yet deallocated
+                std::size_t capacity;
+            };
+            static constexpr std::size_t kSlotsOffset = (sizeof(Header) + kAlignment - 1) / kAlignment * kAlignment;
+
+            Header* header = nullptr;
+
+            static void* slot_memory(Header* h, std::size_t slot){
+                return reinterpret_cast<unsigned char*>(h) + kSlotsOffset + slot*kSlotBytes;
+            }
+
+            static void release(Header* h){
+                if(h->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+                    h->~Header();
+                    ::operator delete(static_cast<void*>(h), std::align_val_t(kAlignment));
+                }
+            }
+
+            // allocate_shared makes a single allocation, of its control block with the Value inside: hand it
+            // the slot, and drop the slot's reference to the block when it is given back.
+            template<typename U>
+            struct SlotAllocator{
+                using value_type = U;
+
+                Header* header;
+                std::size_t slot;
+
+                SlotAllocator(Header* header, std::size_t slot) : header(header), slot(slot) {}
+                template<typename V> SlotAllocator(const SlotAllocator<V>& other) : header(other.header), slot(other.slot) {}
+
+                U* allocate(std::size_t n){
+                    static_assert(sizeof(U) <= kSlotBytes && alignof(U) <= kSlotAlignment,
+                                  "shared_ptr control block does not fit a parameter slot");
+                    assert(("a slot holds a single control block", n == 1));
+                    (void)n;
+                    return static_cast<U*>(slot_memory(header, slot));
+                }
+
+                void deallocate(U*, std::size_t){
+                    release(header);
+                }
+
+                template<typename V> bool operator==(const SlotAllocator<V>& other) const { return header == other.header && slot == other.slot; }
+                template<typename V> bool operator!=(const SlotAllocator<V>& other) const { return !(*this == other); }
+            };
+    };
+
+    using ParameterBlock = BasicParameterBlock<double>;
+    using ParameterBlockf = BasicParameterBlock<float>;
+}
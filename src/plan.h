@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include "block.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Captured execution plan
+    //
+    // Traces the graph of one forward pass once and replays it: the nodes of the captured graph are the fixed
+    // slots, their topological order is computed at capture time, and every later step only rewrites the data
+    // of the leaves (inputs, parameters) before re-running forward() and backward() over the same nodes.
+    // Replaying allocates nothing.
+    //
+    // How to use:
+    //      auto plan = Plan::capture([&](){
+    //          auto y_pred = mlp(X);
+    //          ... build and return the loss ...
+    //      });
+    //      while(training){
+    //          ... write new data into the input leaves ...
+    //          plan.forward();
+    //          for(auto& p : params) p->grad = 0.0;
+    //          plan.backward();
+    //          ... update params ...
+    //      }
+    //
+    // The graph must not be released (backward(false)) while a plan holds it. Every interior node must be able to
+    // re-run its forward pass: a node driven by closures needs a forward_prop (a node built with the original
+    // children-set constructor usually has none). Capturing a graph with such a node throws std::runtime_error
+    // instead of producing a plan that would leave that node's value stale.
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicPlan{
+        public:
+            using Value = BasicValue<T>;
+
+            explicit BasicPlan(std::shared_ptr<Value> root)
+                : root(std::move(root)){
+                for(Value* node : this->root->topological_order()){
+                    if(node->prevs.empty()) continue;
+                    if(uses_closures(node->op) && !node->forward_prop){
+                        throw std::runtime_error(std::string("plan: captured graph has a '") + op_name(node->op) +
+                                                    "' node without a forward_prop, it cannot be replayed");
+                    }
+                    steps.push_back(node);
+                }
+            }
+
+            // Runs build once and captures the graph of the Value it returns.
+            static BasicPlan capture(const std::function<std::shared_ptr<Value>()>& build){
+                return BasicPlan(build());
+            }
+
+            const std::shared_ptr<Value>& output() const { return root; }
+
+            size_t num_nodes() const { return root->topological_order().size(); }
+
+            // Re-evaluates every interior node from the current data of the leaves.
+            void forward(){
+                MICROGRAD_PROFILE_SCOPE(profile::Phase::Forward);
+                for(Value* node : steps){
+                    node->propagate_forward();
+                }
+            }
+
+            // Backpropagates from the output over the cached order; leaf grads accumulate as usual.
+            void backward(){
+                root->backward();
+            }
+
+        private:
+            std::shared_ptr<Value> root;
+            std::vector<Value*> steps;  // interior nodes in topological order
+    };
+
+    using Plan = BasicPlan<double>;
+    using Planf = BasicPlan<float>;
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "op.h"
+
+#ifdef MICROGRAD_PROFILE
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#endif
+
+namespace micrograd::profile{
+
+    //=====================================================================================================================
+    // Profiling
+    //
+    // Compiled in only with MICROGRAD_PROFILE defined (CMake option MICROGRAD_PROFILE); otherwise every hook
+    // below expands to nothing and the API functions are empty inlines, so instrumented code costs nothing.
+    //
+    // Collected per step:
+    //  - nodes created per op, and the bytes allocated for them (node objects, operand lists, tensor buffers)
+    //  - peak number of live Value nodes
+    //  - wall time in forward construction, build_topo, the backward sweep and the parameter update
+    //
+    // How to use:
+    //      while(training){
+    //          ... forward, backward, optimizer.step() ...
+    //          profile::step();
+    //      }
+    //      profile::write_json("profile.json");
+    //      profile::write_chrome_trace("trace.json");    // open in chrome://tracing or Perfetto
+    //
+    // MLP/DenseLayer forward, Plan::forward, Value::backward and Optimizer::step are instrumented already.
+    // Wrap other graph-building code (e.g. the loss) in MICROGRAD_PROFILE_SCOPE(profile::Phase::Forward).
+    // Nested scopes of the same phase are only timed once, at the outermost level.
+    //=====================================================================================================================
+
+    enum class Phase : std::uint8_t{
+        Forward,
+        BuildTopo,
+        Backward,
+        Update
+    };
+
+    constexpr std::size_t kNumPhases = 4;
+
+    inline const char* phase_name(Phase phase){
+        switch(phase){
+            case Phase::Forward:    return "forward";
+            case Phase::BuildTopo:  return "build_topo";
+            case Phase::Backward:   return "backward";
+            case Phase::Update:     return "update";
+        }
+        return "";
+    }
+
+    // Stable identifiers for the report; op_name() is ambiguous (e.g. "+" for Add and AddConst).
+    inline const char* op_key(Op op){
+        switch(op){
+            case Op::None:      return "leaf";
+            case Op::Add:       return "add";
+            case Op::AddConst:  return "add_const";
+            case Op::Mul:       return "mul";
+            case Op::MulConst:  return "mul_const";
+            case Op::Pow:       return "pow";
+            case Op::PowBase:   return "pow_base";
+            case Op::Exp:       return "exp";
+            case Op::Tanh:      return "tanh";
+            case Op::Linear:    return "linear";
+            case Op::LinearTanh:return "linear_tanh";
+            case Op::Sum:       return "sum";
+            case Op::Mean:      return "mean";
+            case Op::Mse:       return "mse";
+            case Op::Index:     return "index";
+            case Op::Stack:     return "stack";
+            case Op::Layer:     return "layer";
+            case Op::Dense:     return "dense";
+            case Op::Checkpoint:return "checkpoint";
+            case Op::Custom:    return "custom";
+        }
+        return "";
+    }
+
+#ifdef MICROGRAD_PROFILE
+
+    constexpr bool enabled = true;
+
+    struct StepRecord{
+        std::array<std::uint64_t, kNumOps> nodes{};
+        std::uint64_t bytes = 0;
+        std::int64_t peak_live_nodes = 0;
+        std::array<std::uint64_t, kNumPhases> time_ns{};
+        double end_us = 0.0;        // since the profiler started
+    };
+
+    namespace detail{
+        using clock_type = std::chrono::steady_clock;
+
+        struct Event{
+            Phase phase;
+            std::uint32_t tid;
+            double begin_us;
+            double dur_us;
+        };
+
+        struct State{
+            const clock_type::time_point origin = clock_type::now();
+
+            // Current step, updated from any thread.
+            std::array<std::atomic<std::uint64_t>, kNumOps> nodes{};
+            std::atomic<std::uint64_t> bytes{0};
+            std::atomic<std::int64_t> peak_live_nodes{0};
+            std::array<std::atomic<std::uint64_t>, kNumPhases> time_ns{};
+
+            std::mutex mutex;               // guards everything below
+            std::vector<StepRecord> steps;
+            std::vector<Event> events;
+            std::atomic<std::uint32_t> next_tid{0};
+        };
+
+        inline State& state(){
+            static State s;
+            return s;
+        }
+
+        inline double now_us(){
+            return std::chrono::duration<double, std::micro>(clock_type::now() - state().origin).count();
+        }
+
+        inline std::uint32_t thread_id(){
+            static thread_local const std::uint32_t tid = state().next_tid++;
+            return tid;
+        }
+
+        inline void raise_peak(std::int64_t live){
+            auto& peak = state().peak_live_nodes;
+            std::int64_t current = peak.load(std::memory_order_relaxed);
+            while(live > current && !peak.compare_exchange_weak(current, live, std::memory_order_relaxed)) {}
+        }
+    }
+
+    inline void on_node(Op op, std::size_t bytes, std::int64_t live){
+        auto& s = detail::state();
+        s.nodes[static_cast<std::size_t>(op)].fetch_add(1, std::memory_order_relaxed);
+        s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        detail::raise_peak(live);
+    }
+
+    inline void on_bytes(std::size_t bytes){
+        detail::state().bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Times one phase on the current thread.
+    class Scope{
+        public:
+            explicit Scope(Phase phase) : phase(phase){
+                if(depth()[index()]++ == 0) begin_us = detail::now_us();
+            }
+
+            ~Scope(){
+                if(--depth()[index()] != 0) return;
+                const double dur_us = detail::now_us() - begin_us;
+                auto& s = detail::state();
+                s.time_ns[index()].fetch_add(static_cast<std::uint64_t>(dur_us*1e3), std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.events.push_back({phase, detail::thread_id(), begin_us, dur_us});
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Phase phase;
+            double begin_us = 0.0;
+
+            std::size_t index() const { return static_cast<std::size_t>(phase); }
+
+            static std::array<int, kNumPhases>& depth(){
+                static thread_local std::array<int, kNumPhases> d{};
+                return d;
+            }
+    };
+
+    // Closes the current step: its counters are recorded and reset. live_nodes seeds the next step's peak.
+    inline void step(std::int64_t live_nodes = 0){
+        auto& s = detail::state();
+        StepRecord record;
+        for(std::size_t i=0; i<kNumOps; ++i){
+            record.nodes[i] = s.nodes[i].exchange(0, std::memory_order_relaxed);
+        }
+        record.bytes = s.bytes.exchange(0, std::memory_order_relaxed);
+        record.peak_live_nodes = s.peak_live_nodes.exchange(live_nodes, std::memory_order_relaxed);
+        for(std::size_t i=0; i<kNumPhases; ++i){
+            record.time_ns[i] = s.time_ns[i].exchange(0, std::memory_order_relaxed);
+        }
+        record.end_us = detail::now_us();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.steps.push_back(record);
+    }
+
+    inline std::vector<StepRecord> steps(){
+        auto& s = detail::state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.steps;
+    }
+
+    // Drops all recorded steps and trace events.
+    inline void reset(){
+        auto& s = detail::state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.steps.clear();
+        s.events.clear();
+    }
+
+    // Per-step summary: {"steps": [{"step", "nodes": {op: count}, "nodes_total", "bytes", "peak_live_nodes",
+    // "time_ns": {phase: ns}}, ...]}
+    inline bool write_json(const std::string& path){
+        std::FILE* out = std::fopen(path.c_str(), "w");
+        if(!out) return false;
+        const auto records = steps();
+        std::fprintf(out, "{\"steps\": [\n");
+        for(std::size_t k=0; k<records.size(); ++k){
+            const StepRecord& r = records[k];
+            std::uint64_t total = 0;
+            std::fprintf(out, "  {\"step\": %zu, \"nodes\": {", k);
+            bool first = true;
+            for(std::size_t i=0; i<kNumOps; ++i){
+                if(!r.nodes[i]) continue;
+                std::fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", op_key(static_cast<Op>(i)), static_cast<unsigned long long>(r.nodes[i]));
+                total += r.nodes[i];
+                first = false;
+            }
+            std::fprintf(out, "}, \"nodes_total\": %llu, \"bytes\": %llu, \"peak_live_nodes\": %lld, \"time_ns\": {",
+                         static_cast<unsigned long long>(total), static_cast<unsigned long long>(r.bytes), static_cast<long long>(r.peak_live_nodes));
+            for(std::size_t i=0; i<kNumPhases; ++i){
+                std::fprintf(out, "%s\"%s\": %llu", i ? ", " : "", phase_name(static_cast<Phase>(i)), static_cast<unsigned long long>(r.time_ns[i]));
+            }
+            std::fprintf(out, "}}%s\n", k+1 < records.size() ? "," : "");
+        }
+        std::fprintf(out, "]}\n");
+        std::fclose(out);
+        return true;
+    }
+
+    // Chrome trace event format: one complete event per timed phase, plus per-step counters for nodes, bytes and
+    // peak live nodes.
+    inline bool write_chrome_trace(const std::string& path){
+        std::FILE* out = std::fopen(path.c_str(), "w");
+        if(!out) return false;
+        auto& s = detail::state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        std::fprintf(out, "{\"traceEvents\": [\n");
+        bool first = true;
+        for(const auto& e : s.events){
+            std::fprintf(out, "%s  {\"name\": \"%s\", \"cat\": \"micrograd\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u}",
+                         first ? "" : ",\n", phase_name(e.phase), e.begin_us, e.dur_us, e.tid);
+            first = false;
+        }
+        for(const auto& r : s.steps){
+            std::uint64_t total = 0;
+            for(auto n : r.nodes) total += n;
+            std::fprintf(out, "%s  {\"name\": \"graph\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, \"args\": {\"nodes\": %llu, \"bytes\": %llu, \"peak_live_nodes\": %lld}}",
+                         first ? "" : ",\n", r.end_us, static_cast<unsigned long long>(total), static_cast<unsigned long long>(r.bytes), static_cast<long long>(r.peak_live_nodes));
+            first = false;
+        }
+        std::fprintf(out, "\n], \"displayTimeUnit\": \"ms\"}\n");
+        std::fclose(out);
+        return true;
+    }
+
+#define MICROGRAD_PROFILE_CONCAT_(a, b) a##b
+#define MICROGRAD_PROFILE_CONCAT(a, b) MICROGRAD_PROFILE_CONCAT_(a, b)
+#define MICROGRAD_PROFILE_SCOPE(phase) ::micrograd::profile::Scope MICROGRAD_PROFILE_CONCAT(microgradProfileScope, __LINE__)(phase)
+#define MICROGRAD_PROFILE_NODE(op, bytes, live) ::micrograd::profile::on_node(op, bytes, live)
+#define MICROGRAD_PROFILE_BYTES(bytes) ::micrograd::profile::on_bytes(bytes)
+
+#else
+
+    constexpr bool enabled = false;
+
+    inline void step(std::int64_t = 0) {}
+    inline void reset() {}
+    template<typename Path> inline bool write_json(const Path&) { return false; }
+    template<typename Path> inline bool write_chrome_trace(const Path&) { return false; }
+
+#define MICROGRAD_PROFILE_SCOPE(phase) ((void)0)
+#define MICROGRAD_PROFILE_NODE(op, bytes, live) ((void)0)
+#define MICROGRAD_PROFILE_BYTES(bytes) ((void)0)
+
+#endif
+}
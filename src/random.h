@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Hashing for deterministic randomness
+    //
+    // SplitMix64 finalizer: a bijection on 64 bits with full avalanche. Parameter initialization (init.h) and
+    // the dataset shuffle (dataset.h) derive all their random numbers from it, so a seed gives the same draws
+    // on every platform and standard library.
+    //=====================================================================================================================
+
+    inline std::uint64_t splitmix64(std::uint64_t z){
+        z += 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+}
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nn.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Inference server
+    //
+    // An in-process server: callers submit one sample at a time and get a future for its outputs. A pool of
+    // worker threads drains a shared queue in dynamic micro-batches. A worker starts a batch as soon as
+    // max_batch requests are waiting, or when the oldest waiting request has been queued for max_delay,
+    // whichever comes first, and runs it through the model's batched predict. Under light load requests go
+    // out almost alone after at most max_delay; under heavy load batches fill up and the per-sample cost drops.
+    //
+    // Every request's queue time (submit to batch start) and latency (submit to result) are recorded in
+    // constant-memory histograms, together with the distribution of batch sizes.
+    //
+    // How to use:
+    //      ServerOptions options;
+    //      options.max_batch = 32;
+    //      options.max_delay = std::chrono::microseconds(200);
+    //      InferenceServer server(mlp, options);
+    //      auto y = server.submit({0.5, -1.0, 2.0}).get();
+    //      server.stats().print(stderr);
+    //
+    // Any model with a batched predict can be served through the BatchFn constructor, e.g. a MappedModel:
+    //      InferenceServer server(model.num_in(), model.num_out(),
+    //                             [&](const double* X, size_t n, double* Y){ model.predict(X, n, Y); });
+    //
+    // The model must stay alive and unchanged while the server runs; predict is called from several workers
+    // at once.
+    //=====================================================================================================================
+
+    struct ServerOptions{
+        size_t max_batch = 32;
+        std::chrono::microseconds max_delay{500};
+        size_t num_workers = std::max<size_t>(1, std::thread::hardware_concurrency());
+        // submit() blocks while this many requests are waiting.
+        size_t queue_capacity = 1 << 16;
+    };
+
+    // Histogram of durations in nanoseconds with 64 linear buckets per power of two: constant memory, and
+    // any percentile is reported within 1/64 of its true value.
+    class LatencyHistogram{
+        public:
+            void record(std::uint64_t ns){
+                ++counts[index(ns)];
+                ++total;
+                sum_ns += ns;
+                max_ns = std::max(max_ns, ns);
+            }
+
+            void merge(const LatencyHistogram& other){
+                for(size_t i=0; i<counts.size(); ++i) counts[i] += other.counts[i];
+                total += other.total;
+                sum_ns += other.sum_ns;
+                max_ns = std::max(max_ns, other.max_ns);
+            }
+
+            std::uint64_t count() const { return total; }
+            double mean_us() const { return total ? 1e-3*static_cast<double>(sum_ns)/total : 0.0; }
+            double max_us() const { return 1e-3*static_cast<double>(max_ns); }
+
+            // Smallest bucket bound below which a fraction q of the samples lie, in microseconds.
+            double percentile_us(double q) const{
+                if(total == 0) return 0.0;
+                const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q*total)));
+                std::uint64_t seen = 0;
+                for(size_t i=0; i<counts.size(); ++i){
+                    seen += counts[i];
+                    if(seen >= rank) return 1e-3*static_cast<double>(std::min(upper_bound(i), max_ns));
+                }
+                return max_us();
+            }
+
+        private:
+            static constexpr int kSubBits = 6;
+            static constexpr std::uint64_t kSub = 1 << kSubBits;
+            static constexpr int kMaxExponent = 44;     // ~4.9 hours
+
+            std::array<std::uint64_t, (kMaxExponent - kSubBits + 2)*kSub> counts{};
+            std::uint64_t total = 0;
+            std::uint64_t sum_ns = 0;
+            std::uint64_t max_ns = 0;
+
+            static size_t index(std::uint64_t ns){
+                if(ns < kSub) return static_cast<size_t>(ns);
+                int exponent = 63 - __builtin_clzll(ns);
+                if(exponent > kMaxExponent){
+                    exponent = kMaxExponent;
+                    ns = (std::uint64_t(1) << (kMaxExponent + 1)) - 1;
+                }
+                const int shift = exponent - kSubBits;
+                return static_cast<size_t>((shift + 1)*kSub + ((ns >> shift) - kSub));
+            }
+
+            static std::uint64_t upper_bound(size_t i){
+                const size_t group = i / kSub, sub = i % kSub;
+                if(group == 0) return sub;
+                return ((kSub + sub + 1) << (group - 1)) - 1;
+            }
+    };
+
+    struct ServerStats{
+        std::uint64_t requests = 0;
+        std::uint64_t batches = 0;
+        std::vector<std::uint64_t> batch_sizes;     // batch_sizes[k] = number of batches of k requests
+        LatencyHistogram queue;                     // submit to batch start
+        LatencyHistogram latency;                   // submit to result
+        double elapsed_s = 0.0;                     // since the server started
+
+        double mean_batch() const { return batches ? static_cast<double>(requests)/batches : 0.0; }
+        double throughput() const { return elapsed_s > 0.0 ? requests/elapsed_s : 0.0; }
+
+        void print(std::FILE* out) const{
+            std::fprintf(out, "requests %llu in %.3f s (%.0f req/s), batches %llu, mean batch %.2f\n",
+                         static_cast<unsigned long long>(requests), elapsed_s, throughput(),
+                         static_cast<unsigned long long>(batches), mean_batch());
+            for(const auto& [name, h] : {std::pair<const char*, const LatencyHistogram*>{"queue", &queue}, {"latency", &latency}}){
+                std::fprintf(out, "%-8s us: mean %.1f  p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n", name,
+                             h->mean_us(), h->percentile_us(0.5), h->percentile_us(0.99), h->percentile_us(0.999), h->max_us());
+            }
+            std::fprintf(out, "batch size histogram:");
+            for(size_t k=1; k<batch_sizes.size(); ++k){
+                if(batch_sizes[k]) std::fprintf(out, " %zu:%llu", k, static_cast<unsigned long long>(batch_sizes[k]));
+            }
+            std::fprintf(out, "\n");
+        }
+
+        // {"requests", "batches", "elapsed_s", "throughput", "mean_batch", "batch_sizes": {size: count},
+        //  "queue_us"/"latency_us": {"mean", "p50", "p99", "p999", "max"}}
+        std::string to_json() const{
+            std::string s;
+            char buf[256];
+            std::snprintf(buf, sizeof(buf), "{\"requests\": %llu, \"batches\": %llu, \"elapsed_s\": %.6f, \"throughput\": %.1f, \"mean_batch\": %.3f, \"batch_sizes\": {",
+                          static_cast<unsigned long long>(requests), static_cast<unsigned long long>(batches), elapsed_s, throughput(), mean_batch());
+            s += buf;
+            bool first = true;
+            for(size_t k=1; k<batch_sizes.size(); ++k){
+                if(!batch_sizes[k]) continue;
+                std::snprintf(buf, sizeof(buf), "%s\"%zu\": %llu", first ? "" : ", ", k, static_cast<unsigned long long>(batch_sizes[k]));
+                s += buf;
+                first = false;
+            }
+            s += "}";
+            for(const auto& [name, h] : {std::pair<const char*, const LatencyHistogram*>{"queue_us", &queue}, {"latency_us", &latency}}){
+                std::snprintf(buf, sizeof(buf), ", \"%s\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}", name,
+                              h->mean_us(), h->percentile_us(0.5), h->percentile_us(0.99), h->percentile_us(0.999), h->max_us());
+                s += buf;
+            }
+            s += "}";
+            return s;
+        }
+    };
+
+    class InferenceServer{
+        public:
+            // Runs n samples: X is (n x num_in) row-major, Y is (n x num_out).
+            using BatchFn = std::function<void(const double* X, size_t n, double* Y)>;
+
+            InferenceServer(size_t num_in, size_t num_out, BatchFn predict, ServerOptions options = {})
+                : num_in(num_in), num_out(num_out), predict(std::move(predict)), options(options){
+                assert(("max_batch must be at least 1", options.max_batch >= 1));
+                reset_stats();
+                for(size_t t=0; t<std::max<size_t>(1, options.num_workers); ++t){
+                    workers.emplace_back([this](){ worker_loop(); });
+                }
+            }
+
+            InferenceServer(const MLP& mlp, ServerOptions options = {})
+                : InferenceServer(mlp.layers.front().num_in, mlp.layers.back().num_out,
+                                  [&mlp](const double* X, size_t n, double* Y){ mlp.predict(X, n, Y); }, options) {}
+
+            // Serves every request already submitted, then stops the workers.
+            ~InferenceServer(){
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                request_ready.notify_all();
+                for(auto& w : workers){
+                    w.join();
+                }
+            }
+
+            InferenceServer(const InferenceServer&) = delete;
+            InferenceServer& operator=(const InferenceServer&) = delete;
+
+            std::future<std::vector<double>> submit(std::vector<double> x){
+                assert(("input size must match the model's num_in", x.size() == num_in));
+                Request request{std::move(x), {}, clock_type::now()};
+                auto result = request.result.get_future();
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    space_ready.wait(lock, [this](){ return queue.size() < options.queue_capacity; });
+                    queue.push_back(std::move(request));
+                }
+                request_ready.notify_one();
+                return result;
+            }
+
+            ServerStats stats() const{
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                ServerStats s = collected;
+                s.elapsed_s = std::chrono::duration<double>(clock_type::now() - started).count();
+                return s;
+            }
+
+            // Clears the collected statistics and restarts the clock, e.g. after a warm-up.
+            void reset_stats(){
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                collected = ServerStats();
+                collected.batch_sizes.assign(options.max_batch + 1, 0);
+                started = clock_type::now();
+            }
+
+            const ServerOptions& config() const { return options; }
+
+        private:
+            using clock_type = std::chrono::steady_clock;
+
+            struct Request{
+                std::vector<double> x;
+                std::promise<std::vector<double>> result;
+                clock_type::time_point submitted;
+                clock_type::time_point answered{};      // set by run_batch when the result is delivered
+            };
+
+            const size_t num_in;
+            const size_t num_out;
+            BatchFn predict;
+            const ServerOptions options;
+
+            std::mutex mutex;                           // guards queue and stopping
+            std::condition_variable request_ready;
+            std::condition_variable space_ready;
+            std::deque<Request> queue;
+            bool stopping = false;
+            std::vector<std::thread> workers;
+
+            mutable std::mutex stats_mutex;
+            ServerStats collected;
+            clock_type::time_point started;
+
+            void worker_loop(){
+                std::vector<Request> batch;
+                std::vector<double> X, Y;
+                while(true){
+                    bool more = false;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        request_ready.wait(lock, [this](){ return stopping || !queue.empty(); });
+                        if(queue.empty()) return;
+                        // Wait for a full batch, at most until the oldest waiting request's deadline.
+                        while(!stopping && !queue.empty() && queue.size() < options.max_batch){
+                            const auto deadline = queue.front().submitted + options.max_delay;
+                            if(clock_type::now() >= deadline) break;
+                            request_ready.wait_until(lock, deadline);
+                        }
+                        if(queue.empty()) continue;     // another worker took them
+                        const size_t n = std::min(options.max_batch, queue.size());
+                        for(size_t i=0; i<n; ++i){
+                            batch.push_back(std::move(queue.front()));
+                            queue.pop_front();
+                        }
+                        more = !queue.empty();
+                    }
+                    space_ready.notify_all();
+                    if(more) request_ready.notify_one();
+                    run_batch(batch, X, Y);
+                    batch.clear();
+                }
+            }
+
+            void run_batch(std::vector<Request>& batch, std::vector<double>& X, std::vector<double>& Y){
+                const size_t n = batch.size();
+                const auto start = clock_type::now();
+                X.resize(n*num_in);
+                Y.resize(n*num_out);
+                for(size_t r=0; r<n; ++r){
+                    std::copy(batch[r].x.begin(), batch[r].x.end(), X.begin() + r*num_in);
+                }
+                predict(X.data(), n, Y.data());
+
+                for(size_t r=0; r<n; ++r){
+                    batch[r].result.set_value(std::vector<double>(Y.begin() + r*num_out, Y.begin() + (r+1)*num_out));
+                    batch[r].answered = clock_type::now();
+                }
+
+                // Two bucket increments per request, straight into the collected histograms.
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                collected.requests += n;
+                collected.batches += 1;
+                collected.batch_sizes[n] += 1;
+                for(const Request& request : batch){
+                    collected.queue.record(std::chrono::duration_cast<std::chrono::nanoseconds>(start - request.submitted).count());
+                    collected.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(request.answered - request.submitted).count());
+                }
+            }
+    };
+
+    //=====================================================================================================================
+    // Load generator
+    //
+    // Drives a server for a fixed time with random inputs and returns its statistics for that period. Closed
+    // loop (rate = 0): `clients` threads each submit a request and wait for it before sending the next. Open
+    // loop (rate > 0): requests arrive as a Poisson process of the given rate, regardless of how fast the
+    // server answers, which is what exposes queueing delay.
+    //=====================================================================================================================
+
+    struct LoadOptions{
+        double duration_s = 2.0;
+        double warmup_s = 0.2;
+        size_t clients = 8;
+        double rate = 0.0;              // requests per second; 0 = closed loop
+        std::uint64_t seed = 1;
+    };
+
+    inline ServerStats generate_load(InferenceServer& server, size_t num_in, const LoadOptions& load){
+        using clock_type = std::chrono::steady_clock;
+        auto run_for = [&](double seconds){
+            const auto end = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+            if(load.rate > 0.0){
+                std::mt19937_64 gen(load.seed);
+                std::uniform_real_distribution<> dis(-1.0, 1.0);
+                std::exponential_distribution<> gap(load.rate);
+                std::vector<std::future<std::vector<double>>> pending;
+                auto next = clock_type::now();
+                while(next < end){
+                    std::this_thread::sleep_until(next);
+                    std::vector<double> x(num_in);
+                    for(auto& v : x) v = dis(gen);
+                    pending.push_back(server.submit(std::move(x)));
+                    next += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(gap(gen)));
+                }
+                for(auto& f : pending) f.get();
+                return;
+            }
+            std::vector<std::thread> clients;
+            for(size_t c=0; c<std::max<size_t>(1, load.clients); ++c){
+                clients.emplace_back([&, c](){
+                    std::mt19937_64 gen(load.seed + c);
+                    std::uniform_real_distribution<> dis(-1.0, 1.0);
+                    std::vector<double> x(num_in);
+                    while(clock_type::now() < end){
+                        for(auto& v : x) v = dis(gen);
+                        server.submit(x).get();
+                    }
+                });
+            }
+            for(auto& t : clients) t.join();
+        };
+
+        if(load.warmup_s > 0.0) run_for(load.warmup_s);
+        server.reset_stats();
+        run_for(load.duration_s);
+        return server.stats();
+    }
+}
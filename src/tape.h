@@ -0,0 +1,297 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+namespace micrograd{
+namespace tape{
+
+    //=====================================================================================================================
+    // Arena-backed tape engine
+    //
+    // An alternative to the shared_ptr graph in block.h. Every operation is appended to a flat tape:
+    // an op code, up to two operand indices, an optional scalar constant and the data/grad of the result,
+    // each kept in its own contiguous array. Operands are always recorded before their results, so the
+    // tape itself is a topological order and backward() is a single reverse sweep, no sorting needed.
+    //
+    // How to use:
+    //      Tape tape;
+    //      auto w = tape.leaf(-3.0);       // parameters first
+    //      tape.freeze();                  // everything recorded so far survives reset()
+    //      while(training){
+    //          auto x = tape.leaf(2.0);
+    //          auto y = ((*w) * (*x))->tanh();
+    //          y.backward();
+    //          w.data() += -0.1 * w.grad();
+    //          tape.zero_grad();
+    //          tape.reset();               // O(1), the arena keeps its capacity
+    //      }
+    //=====================================================================================================================
+
+    enum class OpCode : std::uint8_t{
+        Leaf,
+        Add,        // a + b
+        Sub,        // a - b
+        Mul,        // a * b
+        Div,        // a / b
+        AddConst,   // a + c
+        MulConst,   // a * c
+        Pow,        // a ^ c
+        PowBase,    // c ^ a
+        Exp,        // exp(a)
+        Tanh        // tanh(a)
+    };
+
+    class Tape;
+
+    // Lightweight handle to a tape entry. It is two words, so it is passed and returned by value.
+    class Var{
+        public:
+            Tape* tape;
+            std::uint32_t idx;
+
+            Var() : tape(nullptr), idx(0) {}
+            Var(Tape* tape, std::uint32_t idx) : tape(tape), idx(idx) {}
+
+            double& data() const;
+            double& grad() const;
+
+            // Dereferencing a Var yields the Var itself, so expressions written against the shared_ptr
+            // engine, e.g. (*a) + (*b) or a->tanh(), compile unchanged against the tape.
+            const Var& operator*() const { return *this; }
+            const Var* operator->() const { return this; }
+
+            Var pow(double other) const;
+            Var pow_with_base(double other) const;
+            Var exp() const;
+            Var tanh() const;
+
+            void backward() const;
+    };
+
+    class Tape{
+        public:
+            explicit Tape(std::size_t capacity = 1024) { grow(capacity); }
+
+            Tape(const Tape&) = delete;
+            Tape& operator=(const Tape&) = delete;
+
+            std::size_t size() const { return num_nodes; }
+            std::size_t capacity() const { return cap; }
+
+            // Arena bytes spent per recorded node.
+            static constexpr std::size_t bytes_per_node(){
+                return sizeof(OpCode) + 2*sizeof(std::uint32_t) + 3*sizeof(double);
+            }
+
+            Var leaf(double value){
+                return push(OpCode::Leaf, 0, 0, 0.0, value);
+            }
+
+            // Everything recorded up to now (typically the parameters) survives reset().
+            void freeze() { base = num_nodes; }
+
+            // Drops every entry recorded after freeze(). Capacity is retained so the next
+            // iteration records without allocating.
+            void reset() { num_nodes = base; }
+
+            // Zeroes the gradients of the frozen prefix (the parameters).
+            void zero_grad() { std::memset(grads.data(), 0, base*sizeof(double)); }
+
+            //=====================================================================================================================
+            // Recording
+            //=====================================================================================================================
+
+            Var push(OpCode op, std::uint32_t lhs, std::uint32_t rhs, double constant, double value){
+                if(num_nodes == cap){
+                    grow(std::max<std::size_t>(1, 2*cap));
+                }
+                std::uint32_t i = static_cast<std::uint32_t>(num_nodes++);
+                ops[i] = op;
+                lhs_idx[i] = lhs;
+                rhs_idx[i] = rhs;
+                consts[i] = constant;
+                values[i] = value;
+                grads[i] = 0.0;
+                return Var(this, i);
+            }
+
+            double& data(std::uint32_t i) { return values[i]; }
+            double& grad(std::uint32_t i) { return grads[i]; }
+
+            //=====================================================================================================================
+            // Backpropagation logic
+            //
+            // The tape is already in topological order: sweep from the root back to the frozen prefix.
+            // Gradients of the non-frozen entries are cleared first, so backward() may be called repeatedly.
+            //=====================================================================================================================
+
+            void backward(std::uint32_t root){
+                assert(("root must live on this tape", root < num_nodes));
+                if(root >= base){
+                    std::memset(grads.data() + base, 0, (root + 1 - base)*sizeof(double));
+                }
+                grads[root] = 1.0;
+
+                for(std::size_t k = root + 1; k-- > 0;){
+                    const double g = grads[k];
+                    if(g == 0.0) continue;
+                    const std::uint32_t a = lhs_idx[k];
+                    const std::uint32_t b = rhs_idx[k];
+                    const double c = consts[k];
+                    switch(ops[k]){
+                        case OpCode::Leaf:
+                            break;
+                        case OpCode::Add:
+                            grads[a] += g;
+                            grads[b] += g;
+                            break;
+                        case OpCode::Sub:
+                            grads[a] += g;
+                            grads[b] -= g;
+                            break;
+                        case OpCode::Mul:
+                            grads[a] += values[b] * g;
+                            grads[b] += values[a] * g;
+                            break;
+                        case OpCode::Div:
+                            grads[a] += g / values[b];
+                            grads[b] += -values[a] / (values[b] * values[b]) * g;
+                            break;
+                        case OpCode::AddConst:
+                            grads[a] += g;
+                            break;
+                        case OpCode::MulConst:
+                            grads[a] += c * g;
+                            break;
+                        case OpCode::Pow:
+                            grads[a] += (c * std::pow(values[a], c - 1)) * g;
+                            break;
+                        case OpCode::PowBase:
+                            grads[a] += (values[k] * std::log(c)) * g;
+                            break;
+                        case OpCode::Exp:
+                            grads[a] += values[k] * g;
+                            break;
+                        case OpCode::Tanh:
+                            grads[a] += (1 - values[k]*values[k]) * g;
+                            break;
+                    }
+                }
+            }
+
+        private:
+            std::size_t num_nodes = 0;
+            std::size_t base = 0;
+            std::size_t cap = 0;
+
+            // Structure-of-arrays storage, one slot per recorded op.
+            std::vector<OpCode> ops;
+            std::vector<std::uint32_t> lhs_idx;
+            std::vector<std::uint32_t> rhs_idx;
+            std::vector<double> consts;
+            std::vector<double> values;
+            std::vector<double> grads;
+
+            void grow(std::size_t new_cap){
+                ops.resize(new_cap);
+                lhs_idx.resize(new_cap);
+                rhs_idx.resize(new_cap);
+                consts.resize(new_cap);
+                values.resize(new_cap);
+                grads.resize(new_cap);
+                cap = new_cap;
+            }
+    };
+
+    //=====================================================================================================================
+    // Var operations
+    //
+    // Mirrors the operator set of Value in block.h:
+    // +, -, *, / between two Vars or a Var and a double, pow, pow_with_base, exp and tanh.
+    //=====================================================================================================================
+
+    inline double& Var::data() const { return tape->data(idx); }
+    inline double& Var::grad() const { return tape->grad(idx); }
+
+    inline Var operator+(const Var& lhs, const Var& rhs){
+        assert(("operands must live on the same tape", lhs.tape == rhs.tape));
+        return lhs.tape->push(OpCode::Add, lhs.idx, rhs.idx, 0.0, lhs.data() + rhs.data());
+    }
+
+    inline Var operator+(const Var& lhs, double rhs){
+        return lhs.tape->push(OpCode::AddConst, lhs.idx, 0, rhs, lhs.data() + rhs);
+    }
+
+    inline Var operator+(double lhs, const Var& rhs){
+        return rhs.tape->push(OpCode::AddConst, rhs.idx, 0, lhs, lhs + rhs.data());
+    }
+
+    inline Var operator-(const Var& lhs, const Var& rhs){
+        assert(("operands must live on the same tape", lhs.tape == rhs.tape));
+        return lhs.tape->push(OpCode::Sub, lhs.idx, rhs.idx, 0.0, lhs.data() - rhs.data());
+    }
+
+    inline Var operator-(const Var& lhs, double rhs){
+        return lhs.tape->push(OpCode::AddConst, lhs.idx, 0, -rhs, lhs.data() - rhs);
+    }
+
+    inline Var operator-(double lhs, const Var& rhs){
+        auto negated = rhs.tape->push(OpCode::MulConst, rhs.idx, 0, -1.0, -rhs.data());
+        return negated + lhs;
+    }
+
+    inline Var operator*(const Var& lhs, const Var& rhs){
+        assert(("operands must live on the same tape", lhs.tape == rhs.tape));
+        return lhs.tape->push(OpCode::Mul, lhs.idx, rhs.idx, 0.0, lhs.data() * rhs.data());
+    }
+
+    inline Var operator*(const Var& lhs, double rhs){
+        return lhs.tape->push(OpCode::MulConst, lhs.idx, 0, rhs, lhs.data() * rhs);
+    }
+
+    inline Var operator*(double lhs, const Var& rhs){
+        return rhs.tape->push(OpCode::MulConst, rhs.idx, 0, lhs, lhs * rhs.data());
+    }
+
+    inline Var operator/(const Var& lhs, const Var& rhs){
+        assert(("operands must live on the same tape", lhs.tape == rhs.tape));
+        return lhs.tape->push(OpCode::Div, lhs.idx, rhs.idx, 0.0, lhs.data() / rhs.data());
+    }
+
+    inline Var operator/(const Var& lhs, double rhs){
+        return lhs * std::pow(rhs, -1.0);
+    }
+
+    inline Var operator/(double lhs, const Var& rhs){
+        return lhs * rhs.pow(-1.0);
+    }
+
+    inline Var Var::pow(double other) const{
+        return tape->push(OpCode::Pow, idx, 0, other, std::pow(data(), other));
+    }
+
+    inline Var Var::pow_with_base(double other) const{
+        return tape->push(OpCode::PowBase, idx, 0, other, std::pow(other, data()));
+    }
+
+    inline Var Var::exp() const{
+        return tape->push(OpCode::Exp, idx, 0, 0.0, std::exp(data()));
+    }
+
+    inline Var Var::tanh() const{
+        double x = data();
+        double t = (std::exp(2*x) - 1) / (std::exp(2*x) + 1);
+        return tape->push(OpCode::Tanh, idx, 0, 0.0, t);
+    }
+
+    inline void Var::backward() const{
+        tape->backward(idx);
+    }
+}
+}
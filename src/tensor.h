@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include "block.h"
+
+namespace micrograd{
+
+    //=====================================================================================================================
+    // Tensor node
+    //
+    // A row-major (rows x cols) block of values that sits in the autograd graph as a single Value.
+    // Tensor-level ops (e.g. DenseLayer) read and write the contiguous values/grads buffers directly,
+    // while from_values()/at() bridge to scalar Values, so tensor ops compose with the regular
+    // Value operators, e.g. for the loss.
+    //
+    // The scalar data/grad inherited from Value are unused.
+    //=====================================================================================================================
+
+    template<typename T>
+    class BasicTensor : public BasicValue<T>{
+        public:
+            using Value = BasicValue<T>;
+
+            std::size_t rows;
+            std::size_t cols;
+            std::vector<T> values;
+            std::vector<T> grads;
+
+            BasicTensor(std::size_t rows, std::size_t cols, Op op = Op::None, std::vector<std::shared_ptr<Value>> children = {}, std::string label="")
+                : Value(T(0), op, std::move(children)), rows(rows), cols(cols), values(rows*cols, T(0)), grads(rows*cols, T(0)) {
+                MICROGRAD_PROFILE_BYTES(sizeof(BasicTensor) - sizeof(Value) + 2*rows*cols*sizeof(T));
+                if(!label.empty()) this->set_label(std::move(label));
+            }
+
+            std::size_t size() const { return values.size(); }
+
+            void zero_grad() override {
+                std::fill(grads.begin(), grads.end(), T(0));
+            }
+
+            // Leaf tensor holding a copy of a row-major buffer, e.g. a batch of inputs. U is converted to T.
+            template<typename U>
+            static std::shared_ptr<BasicTensor> from_data(std::size_t rows, std::size_t cols, const U* data, std::string label=""){
+                auto output = std::make_shared<BasicTensor>(rows, cols, Op::None, std::vector<std::shared_ptr<Value>>{}, label);
+                std::copy(data, data + rows*cols, output->values.begin());
+                return output;
+            }
+
+            // (1 x n) tensor gathering scalar Values. Its gradient is scattered back to them.
+            static std::shared_ptr<BasicTensor> from_values(const std::vector<std::shared_ptr<Value>>& xs){
+                auto output = std::make_shared<BasicTensor>(1, xs.size(), Op::Stack, xs);
+                std::vector<Value*> inputs;
+                inputs.reserve(xs.size());
+                for(size_t i=0; i<xs.size(); ++i){
+                    output->values[i] = xs[i]->data;
+                    inputs.push_back(xs[i].get());
+                }
+                output->forward_prop = [inputs, out = output.get()](){
+                    for(size_t i=0; i<inputs.size(); ++i){
+                        out->values[i] = inputs[i]->data;
+                    }
+                };
+                output->back_prop = [inputs, out = output.get()](){
+                    for(size_t i=0; i<inputs.size(); ++i){
+                        inputs[i]->grad += out->grads[i];
+                    }
+                };
+                return output;
+            }
+
+            // Scalar view of element (r, c).
+            std::shared_ptr<Value> at(std::size_t r, std::size_t c){
+                assert(("index out of range", r < rows && c < cols));
+                const std::size_t k = r*cols + c;
+                auto output = std::make_shared<Value>(values[k], Op::Index, std::vector<std::shared_ptr<Value>>{this->shared_from_this()});
+                output->forward_prop = [this, k, out = output.get()](){
+                    out->data = this->values[k];
+                };
+                output->back_prop = [this, k, out = output.get()](){
+                    this->grads[k] += out->grad;
+                };
+                return output;
+            }
+
+            // Scalar views of all elements, in row-major order.
+            std::vector<std::shared_ptr<Value>> to_values(){
+                std::vector<std::shared_ptr<Value>> outputs;
+                outputs.reserve(size());
+                for(size_t r=0; r<rows; ++r){
+                    for(size_t c=0; c<cols; ++c){
+                        outputs.push_back(at(r, c));
+                    }
+                }
+                return outputs;
+            }
+    };
+
+    using Tensor = BasicTensor<double>;
+    using Tensorf = BasicTensor<float>;
+}
@@ -1,89 +1,61 @@
 #include "visualizer.h"
 
+#include <cstdio>
 #include <string>
 
-namespace micrograd{
-    void trace(const std::shared_ptr<Value>& last_node, 
-               std::set<std::shared_ptr<Value>>& nodes, 
-               std::set<std::pair<std::shared_ptr<Value>, std::shared_ptr<Value>>>& edges){
-        
-        if(nodes.find(last_node) == nodes.end()){
-            nodes.insert(last_node);
-            for(const auto& child : last_node->prevs){
-                edges.insert({child, last_node});
-                trace(child, nodes, edges);
-            }
-        }
-    }
-
-    void draw_value_graph(const std::shared_ptr<Value>& last_node){
-        std::set<std::shared_ptr<Value>> nodes;
-        std::set<std::pair<std::shared_ptr<Value>, std::shared_ptr<Value>>> edges;
-        trace(last_node, nodes, edges);
+#ifdef MICROGRAD_HAVE_GRAPHVIZ
+#include <graphviz/gvc.h>
+#endif
 
+namespace micrograd{
+    // Lays out a DOT file with Graphviz and renders it to svg. Without Graphviz the DOT file is the output.
+    static void render_svg(const std::string& dot_path, const std::string& svg_path){
+#ifdef MICROGRAD_HAVE_GRAPHVIZ
+        std::FILE* in = std::fopen(dot_path.c_str(), "r");
+        if(!in) return;
+        Agraph_t* g = agread(in, nullptr);
+        std::fclose(in);
+        if(!g) return;
         GVC_t* gvc = gvContext();
-        Agraph_t* g = agopen(const_cast<char*>("g"), Agdirected, nullptr);
-        agattr(g, AGNODE, const_cast<char*>("shape"), const_cast<char*>("record"));
-
-        for(const auto& n : nodes){
-            std::string uid = std::to_string(reinterpret_cast<std::uintptr_t>(n.get()));
-            Agnode_t* node = agnode(g, const_cast<char*>(uid.c_str()), 1);
-            
-            std::ostringstream label_stream;
-            label_stream << "{"+ n->label+ " | data " << std::fixed << std::setprecision(2) << n->data << " | grad " << std::fixed << std::setprecision(2) << n->grad << "}";
-            std::string label = label_stream.str();
-            agset(node, const_cast<char*>("label"), const_cast<char*>(label.c_str()));
-
-            if(!n->op.empty()){
-                Agnode_t* opNode = agnode(g, const_cast<char*>((uid + n->op).c_str()), 1);
-                agset(opNode, const_cast<char*>("label"), const_cast<char*>(n->op.c_str()));
-                agedge(g, opNode, node, nullptr, 1);
-            }
-        }
-
-        for(const auto& e : edges){
-            std::string n1_uid = std::to_string(reinterpret_cast<std::uintptr_t>(e.first.get()));
-            std::string n2_uid = std::to_string(reinterpret_cast<std::uintptr_t>(e.second.get())) + e.second->op;
-            agedge(g, agnode(g, const_cast<char*>(n1_uid.c_str()), 0), agnode(g, const_cast<char*>(n2_uid.c_str()), 0), nullptr, 1);
-        }
-
         gvLayout(gvc, g, "dot");
-        gvRenderFilename(gvc, g, "svg", "value_graph.svg");
+        gvRenderFilename(gvc, g, "svg", svg_path.c_str());
         gvFreeLayout(gvc, g);
         agclose(g);
         gvFreeContext(gvc);
+#else
+        (void)dot_path;
+        (void)svg_path;
+#endif
     }
 
-    void draw_nn_graph(class MLP& mlp){
-        GVC_t* gvc = gvContext();
-        Agraph_t* g = agopen(const_cast<char*>("g"), Agdirected, nullptr);
-        agattr(g, AGNODE, const_cast<char*>("shape"), const_cast<char*>("record"));
-
-        for(int i=mlp.layers.size()-1; i>=0; --i){
-            Layer& layer = mlp.layers[i];
-            std::string uid = std::to_string(reinterpret_cast<std::uintptr_t>(&layer));
-            Agnode_t* node = agnode(g, const_cast<char*>(uid.c_str()), 1);
-            
-            std::string label = "{"+ layer.layer_name+ " | # neurons: " +
-                                std::to_string(layer.neurons.size()) +
-                                " | # inputs: " + std::to_string(layer.num_in) +
-                                " | # outputs: "+ std::to_string(layer.num_out) + "}";
-            agset(node, const_cast<char*>("label"), const_cast<char*>(label.c_str()));
-
+    void draw_value_graph(const std::shared_ptr<Value>& last_node){
+        if(!export_graph_dot(last_node, "value_graph.dot")){
+            std::fprintf(stderr, "draw_value_graph: cannot write value_graph.dot\n");
+            return;
         }
-
-        for(int i=mlp.layers.size()-2; i>=0; --i){
-            
-            std::string n1_uid = std::to_string(reinterpret_cast<std::uintptr_t>(&mlp.layers[i]));
-            std::string n2_uid = std::to_string(reinterpret_cast<std::uintptr_t>(&mlp.layers[i+1]));
-            agedge(g, agnode(g, const_cast<char*>(n1_uid.c_str()), 0), agnode(g, const_cast<char*>(n2_uid.c_str()), 0), nullptr, 1);
+        if(last_node->topological_order().size() <= kMaxRenderedNodes){
+            render_svg("value_graph.dot", "value_graph.svg");
         }
+    }
 
-        gvLayout(gvc, g, "dot");
-        gvRenderFilename(gvc, g, "svg", "nn_graph.svg");
-        gvFreeLayout(gvc, g);
-        agclose(g);
-        gvFreeContext(gvc);
-
+    void draw_nn_graph(MLP& mlp){
+        std::FILE* out = std::fopen("nn_graph.dot", "w");
+        if(!out){
+            std::fprintf(stderr, "draw_nn_graph: cannot write nn_graph.dot\n");
+            return;
+        }
+        std::fprintf(out, "digraph g {\n  node [shape=record];\n");
+        for(size_t i=0; i<mlp.layers.size(); ++i){
+            const Layer& layer = mlp.layers[i];
+            std::fprintf(out, "  l%zu [label=\"{%s | # neurons: %zu | # inputs: %d | # outputs: %d}\"];\n", i,
+                         graph_export::escape(layer.layer_name, graph_export::Format::Dot).c_str(),
+                         layer.neurons.size(), layer.num_in, layer.num_out);
+        }
+        for(size_t i=0; i+1<mlp.layers.size(); ++i){
+            std::fprintf(out, "  l%zu -> l%zu;\n", i, i+1);
+        }
+        std::fprintf(out, "}\n");
+        std::fclose(out);
+        render_svg("nn_graph.dot", "nn_graph.svg");
     }
-}
\ No newline at end of file
+}
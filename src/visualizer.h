@@ -1,26 +1,21 @@
 #pragma once
 
-#include <set>
-#include <sstream>
-#include <iomanip>
-#include <graphviz/gvc.h>
-
 #include "block.h"
 #include "nn.h"
+#include "graph_export.h"
 
 namespace micrograd{
 
-    // Helper function to populate nodes and edges
-    void trace(const std::shared_ptr<Value>& last_node, 
-               std::set<std::shared_ptr<Value>>& nodes, 
-               std::set<std::pair<std::shared_ptr<Value>, std::shared_ptr<Value>>>& edges);
-    
-    // Function to draw the calculation graph for "Value"
+    // Function to draw the calculation graph for "Value".
+    // Always writes value_graph.dot (see graph_export.h); when built with Graphviz, graphs of up to
+    // kMaxRenderedNodes nodes are also laid out into value_graph.svg. Larger ones are left as DOT: use
+    // export_graph_dot with a summarizing detail level to inspect them.
+    constexpr size_t kMaxRenderedNodes = 5000;
     void draw_value_graph(const std::shared_ptr<Value>& last_node);
 
     // Function to draw the NN layer graph (not as granular as the value graph).
     // This displays the layer connections and high-level information about each layer
-    // in multi-layer-perceptron (MLP).
-    void draw_nn_graph(class MLP& mlp);
+    // in multi-layer-perceptron (MLP). Writes nn_graph.dot, and nn_graph.svg when built with Graphviz.
+    void draw_nn_graph(MLP& mlp);
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Minimal check macros for the regression tests in this directory. Each test is its own executable; a failed
+// CHECK prints its location and makes the test exit non-zero, but the remaining checks still run.
+
+#include <cstdio>
+#include <cstring>
+
+namespace micrograd_test{
+    inline int failures = 0;
+
+    inline int result(){
+        if(failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return failures ? 1 : 0;
+    }
+}
+
+#define CHECK(cond) \
+    do{ \
+        if(!(cond)){ \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++micrograd_test::failures; \
+        } \
+    } while(0)
+
+// Bitwise equality of two arrays of n scalars.
+#define CHECK_SAME_BITS(a, b, n) CHECK(std::memcmp((a), (b), (n) * sizeof(*(a))) == 0)
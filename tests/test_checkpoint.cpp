@@ -0,0 +1,112 @@
+// Checkpoint regressions: a saved model maps and loads back bit for bit, and files whose layer records point
+// outside the file, even through offsets or shapes chosen to wrap 64-bit arithmetic, are rejected.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "check.h"
+#include "checkpoint.h"
+#include "nn.h"
+
+using namespace micrograd;
+
+namespace{
+
+    std::string temp_path(const std::string& name){
+        return "/tmp/micrograd_test_" + std::to_string(::getpid()) + "_" + name + ".ckpt";
+    }
+
+    std::vector<unsigned char> read_file(const std::string& path){
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void write_file(const std::string& path, const std::vector<unsigned char>& bytes){
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    bool rejects(const std::string& path){
+        try{
+            MappedModel model(path);
+        } catch(const std::runtime_error&){
+            return true;
+        }
+        return false;
+    }
+
+    // save_checkpoint -> MappedModel::predict and load_mlp give the original model's weights and outputs exactly.
+    void round_trip_is_bit_identical(){
+        InitOptions init;
+        init.seed = 21;
+        MLP mlp({5, 16, 7, 3}, init);
+        const std::string path = temp_path("round_trip");
+        save_checkpoint(mlp, path);
+
+        std::vector<double> X(6 * 5), expected(6 * 3), mapped(6 * 3), loaded(6 * 3);
+        for(size_t i=0; i<X.size(); ++i) X[i] = std::cos(0.9 * i);
+        mlp.predict(X.data(), 6, expected.data());
+        {
+            MappedModel model(path);
+            CHECK(model.shape() == std::vector<double>({5, 16, 7, 3}));
+            model.predict(X.data(), 6, mapped.data());
+        }
+        MLP restored = load_mlp(path);
+        restored.predict(X.data(), 6, loaded.data());
+        CHECK_SAME_BITS(mapped.data(), expected.data(), expected.size());
+        CHECK_SAME_BITS(loaded.data(), expected.data(), expected.size());
+
+        auto original = mlp.parameters(), copy = restored.parameters();
+        CHECK(original.size() == copy.size());
+        for(size_t i=0; i<original.size() && i<copy.size(); ++i){
+            CHECK_SAME_BITS(&copy[i]->data, &original[i]->data, 1);
+        }
+        std::remove(path.c_str());
+    }
+
+    // Copies of a valid file with one layer record patched.
+    void malformed_records_are_rejected(){
+        MLP mlp({4, 8, 2});
+        const std::string path = temp_path("malformed");
+        save_checkpoint(mlp, path);
+        const std::vector<unsigned char> valid = read_file(path);
+        CHECK(!rejects(path));
+
+        auto patched = [&](auto edit){
+            std::vector<unsigned char> bytes = valid;
+            auto* records = reinterpret_cast<checkpoint::LayerRecord*>(bytes.data() + sizeof(checkpoint::Header));
+            edit(records);
+            write_file(path, bytes);
+            return rejects(path);
+        };
+
+        // weight_offset + bytes wraps past 2^64 back into the file.
+        CHECK(patched([](checkpoint::LayerRecord* r){ r[1].weight_offset = ~std::uint64_t(0) - 63; }));
+        // bias block starts inside the file but runs past its end.
+        CHECK(patched([&](checkpoint::LayerRecord* r){ r[1].bias_offset = checkpoint::align_up(valid.size() - 8); }));
+        // num_out * num_in * sizeof(double) overflows 64 bits and wraps to a small length.
+        CHECK(patched([](checkpoint::LayerRecord* r){
+            r[0].num_in = 0x80000000u;
+            r[0].num_out = 0x80000000u;
+            r[1].num_in = 0x80000000u;
+        }));
+        // weights aliasing the header and layer table.
+        CHECK(patched([](checkpoint::LayerRecord* r){ r[0].weight_offset = 0; }));
+        std::remove(path.c_str());
+    }
+}
+
+int main(){
+    round_trip_is_bit_identical();
+    malformed_records_are_rejected();
+    return micrograd_test::result();
+}
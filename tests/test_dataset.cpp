@@ -0,0 +1,207 @@
+// Datasets: binary files round-trip and malformed ones are rejected, CSV parses with and without a header
+// row, a shuffled epoch visits every sample exactly once, and prefetching does not change the batches.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "check.h"
+#include "dataset.h"
+
+using namespace micrograd;
+
+namespace{
+
+    std::string temp_path(const std::string& name){
+        return "/tmp/micrograd_test_" + std::to_string(::getpid()) + "_" + name;
+    }
+
+    std::vector<unsigned char> read_file(const std::string& path){
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void write_file(const std::string& path, const void* bytes, std::size_t n){
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(static_cast<const char*>(bytes), n);
+    }
+
+    template<typename F>
+    bool throws(F&& f){
+        try{
+            f();
+        } catch(const std::runtime_error&){
+            return true;
+        }
+        return false;
+    }
+
+    // n samples with 3 features and 2 targets; feature 0 is the sample index, all values exact in float.
+    std::string write_indexed(const std::string& name, std::size_t n){
+        std::vector<double> X(n*3), Y(n*2);
+        for(std::size_t i=0; i<n; ++i){
+            X[i*3] = static_cast<double>(i);
+            X[i*3 + 1] = 0.25 * i;
+            X[i*3 + 2] = -0.5;
+            Y[i*2] = 2.0 * i;
+            Y[i*2 + 1] = 0.125;
+        }
+        const std::string path = temp_path(name);
+        write_binary_dataset(path, X.data(), Y.data(), n, 3, 2);
+        return path;
+    }
+
+    void binary_round_trip(){
+        const std::string path = write_indexed("round_trip.bin", 10);
+        BinaryDataset data(path);
+        CHECK(data.num_features() == 3 && data.num_targets() == 2 && data.num_samples() == 10);
+        float x[3], y[2];
+        std::size_t i = 0;
+        bool exact = true;
+        while(data.next(x, y)){
+            exact = exact && x[0] == i && x[1] == 0.25f * i && x[2] == -0.5f && y[0] == 2.0f * i && y[1] == 0.125f;
+            ++i;
+        }
+        CHECK(i == 10);
+        CHECK(exact);
+        std::remove(path.c_str());
+    }
+
+    void malformed_binary_is_rejected(){
+        const std::string path = write_indexed("malformed.bin", 4);
+        const std::vector<unsigned char> valid = read_file(path);
+
+        write_file(path, valid.data(), valid.size() - 4);
+        CHECK(throws([&](){ BinaryDataset data(path); }));
+
+        auto with_header = [&](std::uint32_t features, std::uint32_t targets, std::uint64_t samples){
+            dataset_detail::Header h;
+            std::memcpy(&h, valid.data(), sizeof(h));
+            h.num_features = features;
+            h.num_targets = targets;
+            h.num_samples = samples;
+            write_file(path, &h, sizeof(h));
+            return throws([&](){ BinaryDataset data(path); });
+        };
+        // The uint32 width sum wraps to 0, so a bare header used to match any sample count.
+        CHECK(with_header(0x80000000u, 0x80000000u, 1));
+        // num_samples * row bytes wraps to 0 in 64 bits.
+        CHECK(with_header(1, 0, std::uint64_t(1) << 62));
+        // Zero-width rows.
+        CHECK(with_header(0, 0, 5));
+        CHECK(with_header(0, 2, 0));
+
+        CHECK(throws([&](){ write_binary_dataset(path, nullptr, nullptr, 0, std::size_t(1) << 32, 1); }));
+        CHECK(throws([&](){ write_binary_dataset(path, nullptr, nullptr, 0, 0, 1); }));
+        std::remove(path.c_str());
+    }
+
+    std::vector<std::vector<float>> read_all(Source& source){
+        std::vector<std::vector<float>> rows;
+        std::vector<float> row(source.num_features() + source.num_targets());
+        while(source.next(row.data(), row.data() + source.num_features())) rows.push_back(row);
+        return rows;
+    }
+
+    void csv_parses_with_and_without_header(){
+        const std::string body = "1.5, 2,-3\r\n4,5e-1,6\n\n7,8,9";
+        const std::vector<std::vector<float>> expected = {{1.5f, 2.0f, -3.0f}, {4.0f, 0.5f, 6.0f}, {7.0f, 8.0f, 9.0f}};
+
+        const std::string plain = temp_path("plain.csv");
+        write_file(plain, body.data(), body.size());
+        CsvDataset data(plain, 1);
+        CHECK(data.num_features() == 2 && data.num_targets() == 1);
+        CHECK(read_all(data) == expected);
+
+        const std::string headed = temp_path("headed.csv");
+        const std::string text = "a,b,target\n" + body;
+        write_file(headed, text.data(), text.size());
+        CsvDataset with_header(headed, 1, true);
+        CHECK(with_header.num_features() == 2);
+        CHECK(read_all(with_header) == expected);
+        // Read as data, the header row does not parse.
+        CHECK(throws([&](){ CsvDataset data(headed, 1); }));
+
+        std::remove(plain.c_str());
+        std::remove(headed.c_str());
+    }
+
+    // Sorted first features of one epoch.
+    std::vector<float> epoch_indices(Source& source, std::uint64_t epoch){
+        source.rewind(epoch);
+        std::vector<float> indices;
+        for(const auto& row : read_all(source)) indices.push_back(row[0]);
+        return indices;
+    }
+
+    void shuffled_epoch_is_a_permutation(){
+        const std::size_t n = 37;
+        const std::string path = write_indexed("shuffle.bin", n);
+        BinaryDataset data(path, true, 9);
+        std::vector<float> identity(n);
+        for(std::size_t i=0; i<n; ++i) identity[i] = static_cast<float>(i);
+
+        for(std::uint64_t epoch : {0, 1}){
+            auto order = epoch_indices(data, epoch);
+            CHECK(order != identity);
+            std::sort(order.begin(), order.end());
+            CHECK(order == identity);
+        }
+        CHECK(epoch_indices(data, 0) != epoch_indices(data, 1));
+
+        std::string text;
+        for(std::size_t i=0; i<n; ++i) text += std::to_string(i) + ",1\n";
+        const std::string csv = temp_path("shuffle.csv");
+        write_file(csv, text.data(), text.size());
+        CsvDataset rows(csv, 1, false, 8, 9);
+        auto order = epoch_indices(rows, 0);
+        CHECK(order != identity);
+        std::sort(order.begin(), order.end());
+        CHECK(order == identity);
+
+        std::remove(path.c_str());
+        std::remove(csv.c_str());
+    }
+
+    std::vector<std::vector<float>> batches(Source& source, bool prefetch){
+        DataLoader loader(source, 4, prefetch);
+        std::vector<std::vector<float>> out;
+        for(int epoch=0; epoch<2; ++epoch){
+            loader.start_epoch();
+            Batch batch;
+            while(loader.next(batch)){
+                std::vector<float> b = batch.x;
+                b.insert(b.end(), batch.y.begin(), batch.y.end());
+                out.push_back(b);
+            }
+        }
+        return out;
+    }
+
+    void prefetch_gives_the_same_batches(){
+        const std::string path = write_indexed("prefetch.bin", 23);
+        BinaryDataset a(path, true, 5), b(path, true, 5);
+        const auto prefetched = batches(a, true);
+        const auto direct = batches(b, false);
+        CHECK(prefetched.size() == 2 * (23 / 4));
+        CHECK(prefetched == direct);
+        std::remove(path.c_str());
+    }
+}
+
+int main(){
+    binary_round_trip();
+    malformed_binary_is_rejected();
+    csv_parses_with_and_without_header();
+    shuffled_epoch_is_a_permutation();
+    prefetch_gives_the_same_batches();
+    return micrograd_test::result();
+}
@@ -0,0 +1,133 @@
+// Engine regressions: backward(false) frees the whole graph, releasing nodes shared with another root does
+// not leave that root's cached topological order pointing at freed nodes, releasing an unrelated graph keeps
+// it, and a chain of a million nodes goes through backward() and destruction without recursion.
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "check.h"
+#include "block.h"
+#include "nn.h"
+
+using namespace micrograd;
+
+// Counts every allocation of the process, to show that a backward pass over a cached order allocates nothing.
+static std::atomic<long> allocations{0};
+
+void* operator new(std::size_t n){
+    ++allocations;
+    if(void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace{
+
+    std::vector<std::shared_ptr<Value>> leaves(const std::vector<double>& xs){
+        std::vector<std::shared_ptr<Value>> out;
+        for(double x : xs) out.push_back(std::make_shared<Value>(x));
+        return out;
+    }
+
+    // backward(false) on an MLP loss frees every graph node and gives the same gradients as backward().
+    void released_graph_is_freed(){
+        InitOptions init;
+        init.seed = 3;
+        MLP mlp({3, 8, 8, 1}, init);
+        auto x = leaves({0.5, -1.0, 0.25});
+        auto target = leaves({0.7});
+        auto params = mlp.parameters();
+
+        std::vector<double> retained;
+        {
+            auto loss = mse(mlp(x), target);
+            loss->backward();
+            for(const auto& p : params){
+                retained.push_back(p->grad);
+                p->grad = 0.0;
+            }
+        }
+
+        const int baseline = Value::nVals;
+        {
+            auto loss = mse(mlp(x), target);
+            CHECK(Value::nVals > baseline);
+            loss->backward(false);
+        }
+        CHECK(Value::nVals == baseline);
+        for(size_t i=0; i<params.size(); ++i){
+            CHECK(params[i]->grad == retained[i]);
+        }
+    }
+
+    // A and B share h. B->backward(false) releases h and x; A's cached order must not be reused.
+    void release_invalidates_shared_orders(){
+        auto p = std::make_shared<Value>(0.3);
+        auto x = p->exp();
+        auto h = x->tanh();
+        auto A = (*h) + 1.0;
+        auto B = (*h) * 2.0;
+        x.reset();
+
+        A->backward();
+        CHECK(A->topological_order().size() == 4);
+        B->backward(false);
+        CHECK(h->prevs.empty());
+
+        // h is a leaf now, so it accumulates like one and p is no longer reached.
+        const double h_before = h->grad, p_before = p->grad;
+        A->backward();
+        CHECK(A->topological_order().size() == 2);
+        CHECK(h->grad == h_before + 1.0);
+        CHECK(p->grad == p_before);
+    }
+
+    // Releasing a graph that shares only leaves with A does not throw away A's cached order: the next
+    // A->backward() allocates nothing, as a replayed Plan relies on.
+    void unrelated_release_keeps_orders(){
+        auto p = std::make_shared<Value>(0.3);
+        auto A = (*p->exp()) * 2.0;
+        A->backward();
+
+        auto B = (*p->tanh()) + 1.0;
+        B->backward(false);
+        CHECK(p->prevs.empty() && p->op == Op::None);
+
+        const long before = allocations;
+        A->backward();
+        CHECK(allocations == before);
+        CHECK(A->topological_order().size() == 3);
+    }
+
+    // x + 1 + 1 + ... a million times: the order, the sweep, the release and the teardown are all iterative.
+    void deep_chain(){
+        const int n = 1000000;
+        const int baseline = Value::nVals;
+        auto x = std::make_shared<Value>(0.0);
+        for(bool retain : {true, false}){
+            {
+                std::shared_ptr<Value> y = x;
+                for(int i=0; i<n; ++i) y = (*y) + 1.0;
+                CHECK(y->data == n);
+                x->grad = 0.0;
+                y->backward(retain);
+                CHECK(x->grad == 1.0);
+                CHECK(y->topological_order().size() == (retain ? n + 1 : 1));
+            }
+            CHECK(Value::nVals == baseline + 1);
+        }
+    }
+}
+
+int main(){
+    released_graph_is_freed();
+    release_invalidates_shared_orders();
+    unrelated_release_keeps_orders();
+    deep_chain();
+    return micrograd_test::result();
+}
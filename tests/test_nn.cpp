@@ -0,0 +1,170 @@
+// MLP evaluation paths: the batched forward agrees with the per-sample graph, and predict() and the
+// checkpointed graph are bit-identical to it. Parameters live in one ParameterBlock per layer.
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "check.h"
+#include "block.h"
+#include "nn.h"
+
+using namespace micrograd;
+
+namespace{
+
+    constexpr size_t kBatch = 5;
+    const std::vector<double> kShape = {4, 8, 6, 3};
+
+    MLP make_mlp(){
+        InitOptions init;
+        init.seed = 11;
+        return MLP(kShape, init);
+    }
+
+    std::vector<double> make_inputs(){
+        std::vector<double> xs(kBatch * 4);
+        for(size_t i=0; i<xs.size(); ++i) xs[i] = std::sin(0.7 * i + 0.3);
+        return xs;
+    }
+
+    std::vector<std::shared_ptr<Value>> row(const std::vector<double>& xs, size_t r){
+        std::vector<std::shared_ptr<Value>> out;
+        for(size_t i=0; i<4; ++i) out.push_back(std::make_shared<Value>(xs[r*4 + i]));
+        return out;
+    }
+
+    bool close(double a, double b){
+        return std::abs(a - b) <= 1e-12 * (1.0 + std::abs(a));
+    }
+
+    // One (batch x num_in) forward and backward gives the outputs and parameter gradients of running each
+    // sample through the scalar graph. The batched kernels may use FMA, so agreement is up to rounding.
+    void batched_matches_per_sample(){
+        MLP mlp = make_mlp();
+        const auto xs = make_inputs();
+        auto params = mlp.parameters();
+
+        std::vector<double> outputs;
+        std::shared_ptr<Value> total;
+        for(size_t r=0; r<kBatch; ++r){
+            for(const auto& y : mlp(row(xs, r))){
+                outputs.push_back(y->data);
+                total = total ? (*total) + (*y) : y;
+            }
+        }
+        total->backward();
+        std::vector<double> grads;
+        for(const auto& p : params){
+            grads.push_back(p->grad);
+            p->grad = 0.0;
+        }
+
+        auto Y = mlp(Tensor::from_data(kBatch, 4, xs.data()));
+        CHECK(Y->rows == kBatch && Y->cols == 3);
+        for(size_t i=0; i<outputs.size(); ++i){
+            CHECK(close(Y->values[i], outputs[i]));
+        }
+        std::vector<std::shared_ptr<Value>> elements;
+        for(size_t r=0; r<kBatch; ++r){
+            for(size_t c=0; c<3; ++c) elements.push_back(Y->at(r, c));
+        }
+        sum(elements)->backward();
+        for(size_t i=0; i<params.size(); ++i){
+            CHECK(close(params[i]->grad, grads[i]));
+        }
+    }
+
+    // predict() runs the operations of the scalar graph in the same order, so its outputs match mlp(x) bit for
+    // bit, one row at a time and over a whole (n x num_in) buffer.
+    void predict_matches_graph(){
+        MLP mlp = make_mlp();
+        const auto xs = make_inputs();
+
+        std::vector<double> expected;
+        for(size_t r=0; r<kBatch; ++r){
+            for(const auto& y : mlp(row(xs, r))) expected.push_back(y->data);
+        }
+
+        std::vector<double> rows;
+        for(size_t r=0; r<kBatch; ++r){
+            const auto y = mlp.predict(std::vector<double>(xs.begin() + r*4, xs.begin() + (r+1)*4));
+            rows.insert(rows.end(), y.begin(), y.end());
+        }
+        CHECK(rows.size() == expected.size());
+        CHECK_SAME_BITS(rows.data(), expected.data(), expected.size());
+
+        std::vector<double> batch(kBatch * 3);
+        mlp.predict(xs.data(), kBatch, batch.data());
+        CHECK_SAME_BITS(batch.data(), expected.data(), expected.size());
+    }
+
+    // Outputs, then the gradients of every parameter and input, of one mse loss through a 6-layer MLP.
+    // keep == nullptr uses the plain graph, an empty keep the default segments.
+    std::vector<double> deep_loss_gradients(const std::vector<size_t>* keep){
+        InitOptions init;
+        init.seed = 13;
+        MLP mlp({4, 8, 8, 8, 8, 8, 3}, init);
+        const auto xs = make_inputs();
+        auto x = row(xs, 1);
+        std::vector<std::shared_ptr<Value>> targets;
+        for(double t : {0.5, -0.25, 0.75}) targets.push_back(std::make_shared<Value>(t));
+
+        const auto y = !keep ? mlp(x) : keep->empty() ? mlp.checkpointed(x) : mlp.checkpointed(x, *keep);
+        mse(y, targets)->backward();
+        std::vector<double> out;
+        for(const auto& v : y) out.push_back(v->data);
+        for(const auto& p : mlp.parameters()) out.push_back(p->grad);
+        for(const auto& v : x) out.push_back(v->grad);
+        return out;
+    }
+
+    // Checkpointed segments replay the same scalar operations during backward, so gradients are unchanged bit
+    // for bit, for the default segments and for explicit ones.
+    void checkpointed_matches_graph(){
+        const auto expected = deep_loss_gradients(nullptr);
+        const std::vector<size_t> default_keep, explicit_keep = {1, 3};
+        for(const auto* keep : {&default_keep, &explicit_keep}){
+            const auto grads = deep_loss_gradients(keep);
+            CHECK(grads.size() == expected.size());
+            CHECK_SAME_BITS(grads.data(), expected.data(), expected.size());
+        }
+    }
+
+    // A layer's parameters are evenly spaced Values in init-counter order, usable in graphs like any other Value,
+    // and they outlive the MLP that made them for as long as something holds them.
+    void parameters_share_a_block(){
+        std::shared_ptr<Value> kept;
+        const int baseline = Value::nVals;
+        {
+            MLP mlp = make_mlp();
+            for(auto& layer : mlp.layers){
+                auto params = layer.parameters();
+                bool strided = true;
+                for(size_t k=1; k<params.size(); ++k){
+                    const auto* prev = reinterpret_cast<const unsigned char*>(params[k-1].get());
+                    strided = strided && reinterpret_cast<const unsigned char*>(params[k].get()) == prev + ParameterBlock::value_stride;
+                }
+                CHECK(strided);
+            }
+            kept = mlp.layers[1].neurons[2].ws[3];
+            auto y = (*kept) * 2.0;
+            y->backward();
+            CHECK(kept->grad == 2.0);
+            CHECK(kept->shared_from_this() == kept);
+        }
+        CHECK(Value::nVals == baseline + 1);
+        kept->data = 0.5;
+        CHECK(((*kept) + 1.0)->data == 1.5);
+        kept.reset();
+        CHECK(Value::nVals == baseline);
+    }
+}
+
+int main(){
+    batched_matches_per_sample();
+    predict_matches_graph();
+    checkpointed_matches_graph();
+    parameters_share_a_block();
+    return micrograd_test::result();
+}
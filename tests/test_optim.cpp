@@ -0,0 +1,153 @@
+// Optimizers: the store groups a layer's parameters into one run, and SGD, Momentum and Adam update scalar
+// Values and tensors in place by their update rules, leaving every grad at zero, for double and float models.
+
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "check.h"
+#include "dense.h"
+#include "nn.h"
+#include "optim.h"
+
+using namespace micrograd;
+
+namespace{
+
+    // The registered parameters: an MLP's Values, one loose Value and a DenseLayer's tensors.
+    template<typename T>
+    struct Model{
+        BasicMLP<T> mlp;
+        std::shared_ptr<BasicValue<T>> loose = std::make_shared<BasicValue<T>>(T(0.25));
+        BasicDenseLayer<T> dense{3, 2};
+        BasicParameterStore<T> store;
+
+        Model() : mlp({3, 4, 2}, InitOptions{Init::XavierUniform, 17}){
+            store.add(mlp.parameters());
+            store.add({loose});
+            store.add(dense.parameters());
+        }
+
+        // Data, then grad, of every parameter in registration order.
+        std::vector<T*> data(){
+            std::vector<T*> out;
+            for(const auto& p : mlp.parameters()) out.push_back(&p->data);
+            out.push_back(&loose->data);
+            for(const auto& t : dense.parameters()){
+                for(auto& x : t->values) out.push_back(&x);
+            }
+            return out;
+        }
+
+        std::vector<T*> grads(){
+            std::vector<T*> out;
+            for(const auto& p : mlp.parameters()) out.push_back(&p->grad);
+            out.push_back(&loose->grad);
+            for(const auto& t : dense.parameters()){
+                for(auto& x : t->grads) out.push_back(&x);
+            }
+            return out;
+        }
+    };
+
+    template<typename T>
+    T gradient(size_t i, int step){
+        return static_cast<T>(std::sin(1.3 * i + 0.7 * step));
+    }
+
+    // Within a few rounding errors of the type: the vectorized tensor paths may round differently from the
+    // scalar reference.
+    template<typename T>
+    bool close(T a, T b){
+        const T tolerance = std::is_same<T, float>::value ? T(1e-5) : T(1e-14);
+        return std::abs(a - b) <= tolerance * (1 + std::abs(b));
+    }
+
+    template<typename T>
+    void store_forms_one_run_per_layer(){
+        Model<T> model;
+        const auto& runs = model.store.runs();
+        CHECK(runs.size() == 3);
+        CHECK(runs.size() == 3 && runs[0].count == 16 && runs[1].count == 10 && runs[2].count == 1);
+        CHECK(runs.size() == 3 && runs[1].offset == 16 && runs[2].offset == 26);
+        CHECK(model.store.tensors().size() == 2 && model.store.tensors()[0].offset == 27);
+        CHECK(model.store.size() == 27 + 3*2 + 2);
+    }
+
+    // Runs three steps of opt with known gradients and checks every parameter against rule, which advances
+    // the reference weight w of parameter i by one step given its gradient g.
+    template<typename Opt, typename T>
+    void check_rule(const std::function<Opt(BasicParameterStore<T>&)>& make,
+                    const std::function<void(size_t i, T& w, T g)>& rule){
+        Model<T> model;
+        Opt opt = make(model.store);
+        auto data = model.data();
+        auto grads = model.grads();
+        std::vector<T> expected;
+        for(T* w : data) expected.push_back(*w);
+
+        for(int step=0; step<3; ++step){
+            for(size_t i=0; i<grads.size(); ++i){
+                *grads[i] = gradient<T>(i, step);
+                rule(i, expected[i], gradient<T>(i, step));
+            }
+            opt.step();
+            bool cleared = true;
+            for(T* g : grads) cleared = cleared && *g == T(0);
+            CHECK(cleared);
+        }
+        for(size_t i=0; i<data.size(); ++i){
+            CHECK(close(*data[i], expected[i]));
+        }
+    }
+
+    template<typename T>
+    void sgd_updates_in_place(){
+        const T lr = T(0.1);
+        check_rule<BasicSGD<T>, T>([&](BasicParameterStore<T>& store){ return BasicSGD<T>(store, lr); },
+                                   [&](size_t, T& w, T g){ w += -lr*g; });
+    }
+
+    template<typename T>
+    void momentum_updates_in_place(){
+        const T lr = T(0.05), mu = T(0.8);
+        std::vector<T> v(64, T(0));
+        check_rule<BasicMomentum<T>, T>([&](BasicParameterStore<T>& store){ return BasicMomentum<T>(store, lr, mu); },
+                                        [&](size_t i, T& w, T g){
+                                            v[i] = mu*v[i] + g;
+                                            w += -lr*v[i];
+                                        });
+    }
+
+    // Bias correction folded into the step size, as in Kingma & Ba, section 2.
+    template<typename T>
+    void adam_updates_in_place(){
+        const T lr = T(0.01), beta1 = T(0.9), beta2 = T(0.99), eps = T(1e-8);
+        std::vector<T> m(64, T(0)), v(64, T(0));
+        std::vector<int> t(64, 0);
+        check_rule<BasicAdam<T>, T>([&](BasicParameterStore<T>& store){ return BasicAdam<T>(store, lr, beta1, beta2, eps); },
+                                    [&](size_t i, T& w, T g){
+                                        ++t[i];
+                                        m[i] = beta1*m[i] + (1 - beta1)*g;
+                                        v[i] = beta2*v[i] + (1 - beta2)*g*g;
+                                        const T step = static_cast<T>(lr * std::sqrt(1 - std::pow(beta2, t[i])) / (1 - std::pow(beta1, t[i])));
+                                        w += -step * m[i] / (std::sqrt(v[i]) + eps);
+                                    });
+    }
+
+    template<typename T>
+    void run_all(){
+        store_forms_one_run_per_layer<T>();
+        sgd_updates_in_place<T>();
+        momentum_updates_in_place<T>();
+        adam_updates_in_place<T>();
+    }
+}
+
+int main(){
+    run_all<double>();
+    run_all<float>();
+    return micrograd_test::result();
+}
@@ -0,0 +1,214 @@
+// Thread-pool paths: the data-parallel trainer and the parallel backward sweep give the same gradients for any
+// number of threads, the trainer works on the master model and refuses shard graphs it cannot run
+// concurrently, and build_mlp builds the same model as the MLP constructor.
+
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "nn.h"
+#include "parallel.h"
+
+using namespace micrograd;
+
+namespace{
+
+    const std::vector<double> kShape = {3, 16, 16, 1};
+
+    const size_t kBatch = 23;
+
+    std::vector<double> batch_inputs(){
+        std::vector<double> X(kBatch*3);
+        for(size_t i=0; i<X.size(); ++i) X[i] = std::cos(0.37 * i);
+        return X;
+    }
+
+    std::vector<double> batch_targets(){
+        std::vector<double> Y(kBatch);
+        for(size_t i=0; i<kBatch; ++i) Y[i] = std::sin(0.5 * i);
+        return Y;
+    }
+
+    // Sum of squared errors of samples [begin, end) through the batched path.
+    std::shared_ptr<Value> shard_loss(MLP& model, size_t begin, size_t end){
+        static const std::vector<double> X = batch_inputs(), Y = batch_targets();
+        auto y = model(Tensor::from_data(end - begin, 3, X.data() + begin*3));
+        std::vector<std::shared_ptr<Value>> errors;
+        for(size_t i=begin; i<end; ++i){
+            errors.push_back((*y->at(i - begin, 0) - Y[i])->pow(2.0));
+        }
+        return sum(errors);
+    }
+
+    std::vector<double> trainer_gradients(size_t num_threads, double* loss_out){
+        InitOptions init;
+        init.seed = 5;
+        MLP mlp(kShape, init);
+        DataParallelTrainer trainer(mlp, 6, num_threads);
+        *loss_out = trainer.compute_gradients(kBatch, shard_loss);
+        std::vector<double> grads;
+        for(const auto& p : mlp.parameters()) grads.push_back(p->grad);
+        return grads;
+    }
+
+    void trainer_is_thread_count_independent(){
+        double loss1 = 0.0, loss3 = 0.0;
+        const auto g1 = trainer_gradients(1, &loss1);
+        const auto g3 = trainer_gradients(3, &loss3);
+        CHECK(g1.size() == g3.size());
+        CHECK_SAME_BITS(g1.data(), g3.data(), g1.size());
+        CHECK(loss1 == loss3);
+        bool nonzero = false;
+        for(double g : g1) nonzero = nonzero || g != 0.0;
+        CHECK(nonzero);
+    }
+
+    // The shards build on the master model (no replica Values) and their summed gradients are those of one
+    // graph over the whole batch, up to the order of the additions.
+    void trainer_matches_whole_batch(){
+        InitOptions init;
+        init.seed = 5;
+        MLP mlp(kShape, init);
+        auto loss = shard_loss(mlp, 0, kBatch);
+        loss->backward(false);
+        std::vector<double> expected;
+        for(const auto& p : mlp.parameters()){
+            expected.push_back(p->grad);
+            p->grad = 0.0;
+        }
+
+        const int live = Value::nVals;
+        DataParallelTrainer trainer(mlp, 0, 3);
+        CHECK(trainer.num_shards() == 3);
+        CHECK(Value::nVals == live);
+        const double total = trainer.compute_gradients(kBatch, shard_loss);
+        CHECK(Value::nVals == live);
+        CHECK(std::abs(total - loss->data) <= 1e-12 * std::abs(loss->data));
+
+        const auto params = mlp.parameters();
+        bool close = params.size() == expected.size();
+        for(size_t i=0; i<params.size() && close; ++i){
+            close = std::abs(params[i]->grad - expected[i]) <= 1e-12 * (1.0 + std::abs(expected[i]));
+        }
+        CHECK(close);
+    }
+
+    template<typename F>
+    bool throws(F&& f){
+        try{
+            f();
+        } catch(const std::runtime_error&){
+            return true;
+        }
+        return false;
+    }
+
+    // A node shared between shards, or a parameter reached as a graph operand by the scalar path, is refused
+    // before anything is backpropagated; the trainer stays usable.
+    void trainer_refuses_shared_nodes(){
+        InitOptions init;
+        init.seed = 5;
+        MLP mlp(kShape, init);
+        DataParallelTrainer trainer(mlp, 4, 2);
+        auto offset = std::make_shared<Value>(0.5);
+        CHECK(throws([&](){
+            trainer.compute_gradients(kBatch, [&](MLP& model, size_t begin, size_t end){
+                return (*shard_loss(model, begin, end)) + (*offset);
+            });
+        }));
+        CHECK(throws([&](){
+            trainer.compute_gradients(kBatch, [&](MLP& model, size_t begin, size_t){
+                std::vector<std::shared_ptr<Value>> x;
+                for(size_t i=0; i<3; ++i) x.push_back(std::make_shared<Value>(0.1 * (begin + i)));
+                return model(x)[0];
+            });
+        }));
+        bool untouched = true;
+        for(const auto& p : mlp.parameters()) untouched = untouched && p->grad == 0.0;
+        CHECK(untouched);
+        CHECK(std::isfinite(trainer.compute_gradients(kBatch, shard_loss)));
+    }
+
+    // Gradients of every parameter and input after one backward sweep over a graph mixing fused scalar neurons,
+    // built-in scalar ops and closure nodes (batched Layer, Tensor::at). num_threads == 0 runs loss->backward().
+    std::vector<double> sweep_gradients(size_t num_threads){
+        InitOptions init;
+        init.seed = 9;
+        MLP mlp({64, 128, 128, 2}, init);
+        std::vector<std::shared_ptr<Value>> x;
+        for(size_t i=0; i<64; ++i) x.push_back(std::make_shared<Value>(std::sin(0.21 * i)));
+        std::vector<double> batch(3*64);
+        for(size_t i=0; i<batch.size(); ++i) batch[i] = std::cos(0.13 * i);
+
+        auto y = mlp(x);
+        auto Y = mlp(Tensor::from_data(3, 64, batch.data()));
+        std::vector<std::shared_ptr<Value>> terms;
+        for(const auto& v : y) terms.push_back((*v - 0.25)->pow(2.0));
+        for(size_t r=0; r<3; ++r) terms.push_back((*Y->at(r, 0)) * (*Y->at(r, 1)));
+        auto loss = sum(terms);
+
+        if(num_threads == 0){
+            loss->backward();
+        } else{
+            ThreadPool pool(num_threads);
+            ParallelBackward sweep(loss, pool);
+            sweep.run();
+        }
+        std::vector<double> grads;
+        for(const auto& p : mlp.parameters()) grads.push_back(p->grad);
+        for(const auto& v : x) grads.push_back(v->grad);
+        return grads;
+    }
+
+    // The widest level of the sweep has far more than kMinParallelEdges edges, so 2 and 3 workers take the
+    // pooled path; 1 worker falls back to the sequential sweep.
+    void parallel_backward_is_bitwise_sequential(){
+        const auto expected = sweep_gradients(0);
+        for(size_t threads : {1, 2, 3}){
+            const auto grads = sweep_gradients(threads);
+            CHECK(grads.size() == expected.size());
+            CHECK_SAME_BITS(grads.data(), expected.data(), expected.size());
+        }
+    }
+
+    template<typename T>
+    std::vector<T> parameter_data(BasicMLP<T>& mlp){
+        std::vector<T> out;
+        for(const auto& p : mlp.parameters()) out.push_back(p->data);
+        return out;
+    }
+
+    // Every scheme, in double and float, with layers large enough to be split into several chunks.
+    void build_mlp_matches_constructor(){
+        const std::vector<double> shape = {300, 400, 17, 3};
+        ThreadPool pool(3);
+        for(Init scheme : {Init::Uniform, Init::XavierUniform, Init::XavierNormal, Init::HeUniform, Init::HeNormal}){
+            InitOptions init;
+            init.scheme = scheme;
+            init.seed = 1234;
+
+            MLP serial(shape, init);
+            MLP parallel = build_mlp(shape, init, pool);
+            const auto expected = parameter_data(serial), built = parameter_data(parallel);
+            CHECK(built.size() == expected.size());
+            CHECK_SAME_BITS(built.data(), expected.data(), expected.size());
+
+            MLPf serialf(shape, init);
+            MLPf parallelf = build_mlp<float>(shape, init, pool);
+            const auto expectedf = parameter_data(serialf), builtf = parameter_data(parallelf);
+            CHECK(builtf.size() == expectedf.size());
+            CHECK_SAME_BITS(builtf.data(), expectedf.data(), expectedf.size());
+        }
+    }
+}
+
+int main(){
+    trainer_is_thread_count_independent();
+    trainer_matches_whole_batch();
+    trainer_refuses_shared_nodes();
+    parallel_backward_is_bitwise_sequential();
+    build_mlp_matches_constructor();
+    return micrograd_test::result();
+}
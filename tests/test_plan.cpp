@@ -0,0 +1,101 @@
+// Plan regressions: replaying a captured graph on new inputs gives the loss and gradients of a freshly built
+// graph without allocating nodes, and a graph with a node that cannot be re-evaluated is refused at capture.
+
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "block.h"
+#include "nn.h"
+#include "plan.h"
+#include "tensor.h"
+
+using namespace micrograd;
+
+namespace{
+
+    std::shared_ptr<Value> sse(MLP& mlp, const std::shared_ptr<Tensor>& X, const std::vector<std::shared_ptr<Value>>& y_gt){
+        auto y_pred = mlp(X);
+        std::vector<std::shared_ptr<Value>> errors;
+        for(size_t i=0; i<y_gt.size(); ++i){
+            auto diff = (*y_pred->at(i, 0)) - (*y_gt[i]);
+            errors.push_back((*diff) * (*diff));
+        }
+        return sum(errors);
+    }
+
+    // Captured on one batch, replayed on another: bitwise the loss and gradients of a graph built on the second
+    // batch, and the number of live Values does not change across replays.
+    void replay_matches_fresh_graph(){
+        InitOptions init;
+        init.seed = 7;
+        MLP mlp({3, 6, 6, 1}, init);
+        auto params = mlp.parameters();
+        const std::vector<double> first = {2.0, 3.0, -1.0, 3.0, -1.0, 0.5, 0.5, 1.0, 1.0, 1.0, 1.0, -1.0};
+        const std::vector<double> second = {-0.5, 0.25, 1.5, 0.0, 2.0, -2.0, 1.0, -0.75, 0.5, -1.0, 0.125, 0.0};
+        std::vector<std::shared_ptr<Value>> y_gt;
+        for(double y : {1.0, -1.0, -1.0, 1.0}) y_gt.push_back(std::make_shared<Value>(y));
+
+        auto X = Tensor::from_data(4, 3, first.data());
+        auto plan = Plan::capture([&](){ return sse(mlp, X, y_gt); });
+        const int live = Value::nVals;
+
+        std::copy(second.begin(), second.end(), X->values.begin());
+        for(int step=0; step<3; ++step){
+            plan.forward();
+            for(auto& p : params) p->grad = 0.0;
+            plan.backward();
+        }
+        CHECK(Value::nVals == live);
+        const double replayed_loss = plan.output()->data;
+        std::vector<double> replayed;
+        for(const auto& p : params){
+            replayed.push_back(p->grad);
+            p->grad = 0.0;
+        }
+
+        auto fresh = sse(mlp, Tensor::from_data(4, 3, second.data()), y_gt);
+        fresh->backward();
+        std::vector<double> expected;
+        for(const auto& p : params) expected.push_back(p->grad);
+
+        CHECK_SAME_BITS(&replayed_loss, &fresh->data, 1);
+        CHECK(replayed.size() == expected.size());
+        CHECK_SAME_BITS(replayed.data(), expected.data(), expected.size());
+    }
+
+    // A node built with the children-set constructor and only a back_prop cannot be re-evaluated; capturing it
+    // must throw in every build type. Giving it a forward_prop makes the same graph capturable.
+    void non_replayable_node_is_refused(){
+        auto a = std::make_shared<Value>(2.0);
+        auto b = std::make_shared<Value>(3.0);
+        auto c = std::make_shared<Value>(6.0, std::set<std::shared_ptr<Value>>{a, b});
+        c->back_prop = [a = a.get(), b = b.get(), c = c.get()](){
+            a->grad += b->data * c->grad;
+            b->grad += a->data * c->grad;
+        };
+        auto loss = (*c) + (*a);
+
+        bool threw = false;
+        try{
+            Plan plan(loss);
+        } catch(const std::runtime_error&){
+            threw = true;
+        }
+        CHECK(threw);
+
+        c->forward_prop = [a = a.get(), b = b.get(), c = c.get()](){ c->data = a->data * b->data; };
+        Plan plan(loss);
+        a->data = 4.0;
+        plan.forward();
+        CHECK(loss->data == 16.0);
+    }
+}
+
+int main(){
+    replay_matches_fresh_graph();
+    non_replayable_node_is_refused();
+    return micrograd_test::result();
+}
@@ -0,0 +1,83 @@
+// Int8 inference: the int8 dot kernel is exact against a scalar reference at every length around its vector
+// widths, and a quantized MLP agrees with the double model within the bounds int8 rounding allows.
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "kernels.h"
+#include "nn.h"
+#include "quantize.h"
+
+using namespace micrograd;
+
+namespace{
+
+    void int8_dot_is_exact(){
+        std::mt19937 gen(3);
+        std::uniform_int_distribution<int> dis(-127, 127);
+        for(std::size_t n : {0, 1, 31, 32, 33, 63, 64, 65, 96, 200, 1000, 4099}){
+            std::vector<std::int8_t> a(n), b(n);
+            for(std::size_t i=0; i<n; ++i){
+                a[i] = static_cast<std::int8_t>(dis(gen));
+                b[i] = static_cast<std::int8_t>(dis(gen));
+            }
+            std::int32_t expected = 0;
+            for(std::size_t i=0; i<n; ++i) expected += static_cast<std::int32_t>(a[i]) * b[i];
+            CHECK(kernels::dot(a.data(), b.data(), n) == expected);
+
+            // Extremes of the range, where pairs of products reach the int16 limit of the maddubs path.
+            std::vector<std::int8_t> hi(n, 127), lo(n, -127);
+            CHECK(kernels::dot(hi.data(), lo.data(), n) == -127 * 127 * static_cast<std::int32_t>(n));
+            CHECK(kernels::dot(lo.data(), lo.data(), n) == 127 * 127 * static_cast<std::int32_t>(n));
+        }
+    }
+
+    void quantized_mlp_agrees(){
+        InitOptions init;
+        init.scheme = Init::XavierUniform;
+        init.seed = 42;
+        MLP mlp({32, 128, 128, 10}, init);
+        QuantizedMLP q(mlp);
+
+        const std::size_t n = 300;
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        std::vector<double> X(n*32);
+        for(auto& v : X) v = dis(gen);
+
+        const QuantizationReport report = quantization_report(mlp, q, X.data(), n);
+        CHECK(report.samples == n && report.outputs == 10);
+        CHECK(report.max_abs_error < 0.05);
+        CHECK(report.mean_abs_error < 0.01);
+        CHECK(report.argmax_agreement >= 0.95);
+
+        const std::size_t num_params = 33*128 + 129*128 + 129*10;
+        CHECK(report.double_bytes == num_params * sizeof(double));
+        CHECK(report.float_bytes == num_params * sizeof(float));
+        CHECK(report.quantized_bytes == q.weight_bytes());
+        CHECK(report.quantized_bytes < report.float_bytes / 2);
+
+        // Every weight is recovered within half a quantization step of its neuron.
+        bool within = true;
+        for(std::size_t l=0; l<q.layers.size(); ++l){
+            const auto& layer = q.layers[l];
+            for(std::size_t j=0; j<layer.num_out; ++j){
+                const auto& ws = mlp.layers[l].neurons[j].ws;
+                for(std::size_t i=0; i<layer.num_in; ++i){
+                    const double w = layer.scale[j] * static_cast<double>(layer.W[j*layer.stride + i]);
+                    within = within && std::abs(w - ws[i]->data) <= 0.5001 * layer.scale[j];
+                }
+            }
+        }
+        CHECK(within);
+    }
+}
+
+int main(){
+    int8_dot_is_exact();
+    quantized_mlp_agrees();
+    return micrograd_test::result();
+}